@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace network {
+namespace bench {
+
+// Keeps the compiler from discarding a value computed only for timing.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+enum class Better { LOWER, HIGHER };
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double value;
+    Better better;
+};
+
+// Collects benchmark results. Timed bodies take an iteration count and run the
+// operation that many times; the count is calibrated so that one repetition lasts about
+// `min_time`, and the reported figure is the median of REPETITIONS repetitions. Bodies
+// with setup that must not be timed return their own elapsed nanoseconds as a double.
+class Suite {
+   public:
+    static constexpr int REPETITIONS = 5;
+
+    Suite(const std::string& filter, std::chrono::milliseconds min_time)
+        : filter_(filter), min_time_(min_time) {}
+
+    // True if `name` passes --filter. Also used with a group prefix ("relay.") to skip
+    // the setup of a whole group of benchmarks.
+    bool enabled(const std::string& name) const {
+        return filter_.empty() || name.compare(0, filter_.size(), filter_) == 0 ||
+               filter_.compare(0, name.size(), name) == 0;
+    }
+
+    // Median nanoseconds per iteration of `body`.
+    template <typename Body>
+    double measure(Body&& body) {
+        size_t iterations = 1;
+        for (;;) {
+            double elapsed = run(body, iterations);
+            if (elapsed >= static_cast<double>(min_time_.count()) * 1e6 / 10 ||
+                iterations >= (size_t{1} << 32)) {
+                double per_iteration = elapsed / static_cast<double>(iterations);
+                iterations = std::max<size_t>(
+                    1, static_cast<size_t>(static_cast<double>(min_time_.count()) * 1e6 /
+                                           std::max(per_iteration, 1e-3)));
+                break;
+            }
+            iterations *= 10;
+        }
+
+        std::vector<double> samples;
+        for (int i = 0; i < REPETITIONS; ++i) {
+            samples.push_back(run(body, iterations) / static_cast<double>(iterations));
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    // Times `body` and records nanoseconds per operation.
+    template <typename Body>
+    void time(const std::string& name, Body&& body) {
+        if (enabled(name)) {
+            record(name, "ns/op", measure(body), Better::LOWER);
+        }
+    }
+
+    void record(const std::string& name, const std::string& unit, double value, Better better) {
+        if (!enabled(name)) {
+            return;
+        }
+        std::printf("%-40s %14.3f %s\n", name.c_str(), value, unit.c_str());
+        std::fflush(stdout);
+        results_.push_back({name, unit, value, better});
+    }
+
+    const std::vector<Result>& results() const { return results_; }
+
+   private:
+    template <typename Body>
+    static double run(Body& body, size_t iterations) {
+        if constexpr (std::is_same_v<decltype(body(iterations)), double>) {
+            return body(iterations);
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::steady_clock::now() - start)
+                                           .count());
+        }
+    }
+
+    std::string filter_;
+    std::chrono::milliseconds min_time_;
+    std::vector<Result> results_;
+};
+
+// Results file, one benchmark per line and sorted by name so that files diff cleanly:
+//
+//   {
+//     "schema": 1,
+//     "build": {"type": "Release", "lto": false, "pgo": "OFF", "compiler": "GNU 12.2.0"},
+//     "benchmarks": [
+//       {"name": "protocol.parse", "unit": "ns/op", "better": "lower", "value": 41.5},
+//       ...
+//     ]
+//   }
+constexpr int RESULTS_SCHEMA = 1;
+
+inline void writeResults(const std::string& path, const std::string& build,
+                         std::vector<Result> results) {
+    std::sort(results.begin(), results.end(),
+              [](const Result& a, const Result& b) { return a.name < b.name; });
+
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Failed to write benchmark results to " + path);
+    }
+    out << "{\n  \"schema\": " << RESULTS_SCHEMA << ",\n  \"build\": " << build
+        << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        char value[32];
+        std::snprintf(value, sizeof(value), "%.6g", results[i].value);
+        out << "    {\"name\": \"" << results[i].name << "\", \"unit\": \"" << results[i].unit
+            << "\", \"better\": \"" << (results[i].better == Better::LOWER ? "lower" : "higher")
+            << "\", \"value\": " << value << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+struct Baseline {
+    std::string build;
+    std::map<std::string, double> values;
+};
+
+// Reads a file written by writeResults; not a general JSON parser.
+inline Baseline readBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to read benchmark baseline " + path);
+    }
+
+    static const std::regex schema_line("\"schema\": ([0-9]+)");
+    static const std::regex build_line("\"build\": (\\{.*\\})");
+    static const std::regex benchmark_line("\"name\": \"([^\"]+)\".*\"value\": ([-+0-9.eEinfa]+)");
+
+    Baseline baseline;
+    std::string line;
+    std::smatch match;
+    while (std::getline(in, line)) {
+        if (std::regex_search(line, match, schema_line) && std::stoi(match[1]) != RESULTS_SCHEMA) {
+            throw std::runtime_error("Unsupported benchmark baseline schema in " + path);
+        } else if (std::regex_search(line, match, build_line)) {
+            baseline.build = match[1];
+        } else if (std::regex_search(line, match, benchmark_line)) {
+            baseline.values[match[1]] = std::stod(match[2]);
+        }
+    }
+    return baseline;
+}
+
+// Prints every result next to its baseline and returns the number of regressions: results
+// more than `threshold` percent worse than the baseline in their `better` direction.
+inline size_t compareWithBaseline(const std::vector<Result>& results, const Baseline& baseline,
+                                  const std::string& build, double threshold) {
+    if (baseline.build != build) {
+        std::printf("\nBaseline was recorded with a different build: %s\n", baseline.build.c_str());
+    }
+
+    std::printf("\n%-40s %14s %14s %9s\n", "benchmark", "baseline", "current", "change");
+    size_t regressions = 0;
+    for (const auto& result : results) {
+        auto it = baseline.values.find(result.name);
+        if (it == baseline.values.end()) {
+            std::printf("%-40s %14s %14.3f %9s\n", result.name.c_str(), "-", result.value, "new");
+            continue;
+        }
+
+        double change = it->second != 0 ? (result.value - it->second) / it->second * 100 : 0;
+        double worse = result.better == Better::LOWER ? change : -change;
+        // A zero baseline, such as no lost datagrams, allows no increase at all.
+        bool regressed = it->second == 0 ? result.value != 0 && (result.value > 0) == (result.better == Better::LOWER)
+                                         : worse > threshold;
+        regressions += regressed ? 1 : 0;
+        std::printf("%-40s %14.3f %14.3f %+8.1f%%%s\n", result.name.c_str(), it->second, result.value,
+                    change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+// Benchmark groups, one per source file.
+void runProtocolBenchmarks(Suite& suite);
+void runSocketBenchmarks(Suite& suite);
+void runRendezvousBenchmarks(Suite& suite);
+void runHandoverBenchmarks(Suite& suite);
+void runCodecBenchmarks(Suite& suite);
+void runRelayBenchmarks(Suite& suite);
+void runTraceBenchmarks(Suite& suite);
+
+}  // namespace bench
+}  // namespace network
@@ -0,0 +1,116 @@
+#include "bench.hpp"
+#include "common/logger.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#ifndef P2P_BUILD_TYPE
+#define P2P_BUILD_TYPE "unknown"
+#endif
+#ifndef P2P_LTO
+#define P2P_LTO 0
+#endif
+#ifndef P2P_PGO
+#define P2P_PGO "OFF"
+#endif
+
+namespace {
+
+struct BenchConfig {
+    std::string out_path;
+    std::string baseline_path;
+    double threshold = 10;
+    std::string filter;
+    std::chrono::milliseconds min_time{100};
+};
+
+void printUsage(const char* program_name) {
+    std::cerr << "Usage: " << program_name << " [options]\n";
+    std::cerr << "\nOptions:\n";
+    std::cerr << "  --out <file>        Write results as JSON\n";
+    std::cerr << "  --baseline <file>   Compare with a results file, exit 1 on regressions\n";
+    std::cerr << "  --threshold <pct>   Allowed slowdown against the baseline (default: 10)\n";
+    std::cerr << "  --filter <prefix>   Run only benchmarks whose name starts with prefix\n";
+    std::cerr << "  --min-time <ms>     Duration of one timed repetition (default: 100)\n";
+    std::cerr << "  --help              Show this help message\n";
+}
+
+BenchConfig parseArguments(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--out" && i + 1 < argc) {
+            config.out_path = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            config.baseline_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            config.threshold = std::stod(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            config.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            config.min_time = std::chrono::milliseconds(std::stoul(argv[++i]));
+        } else if (arg == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return config;
+}
+
+std::string buildDescription() {
+    return std::string("{\"type\": \"") + P2P_BUILD_TYPE + "\", \"lto\": " +
+           (P2P_LTO ? "true" : "false") + ", \"pgo\": \"" + P2P_PGO + "\", \"compiler\": \"" +
+#if defined(__clang__)
+           "Clang " + __clang_version__ +
+#elif defined(__GNUC__)
+           "GNU " + __VERSION__ +
+#endif
+           "\"}";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    using namespace network;
+
+    try {
+        BenchConfig config = parseArguments(argc, argv);
+        // The code under test logs at INFO and DEBUG; only the logger benchmarks print.
+        Logger::setLevel(Logger::Level::WARNING);
+
+        bench::Suite suite(config.filter, config.min_time);
+        bench::runProtocolBenchmarks(suite);
+        bench::runCodecBenchmarks(suite);
+        bench::runSocketBenchmarks(suite);
+        bench::runRendezvousBenchmarks(suite);
+        bench::runHandoverBenchmarks(suite);
+        bench::runRelayBenchmarks(suite);
+        bench::runTraceBenchmarks(suite);
+
+        std::string build = buildDescription();
+        if (!config.out_path.empty()) {
+            bench::writeResults(config.out_path, build, suite.results());
+            std::cout << "\nResults written to " << config.out_path << std::endl;
+        }
+
+        if (!config.baseline_path.empty()) {
+            auto baseline = bench::readBaseline(config.baseline_path);
+            size_t regressions =
+                bench::compareWithBaseline(suite.results(), baseline, build, config.threshold);
+            if (regressions > 0) {
+                std::cout << "\n" << regressions << " benchmark(s) regressed by more than "
+                          << config.threshold << "%" << std::endl;
+                return 1;
+            }
+            std::cout << "\nNo regressions beyond " << config.threshold << "%" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "bench.hpp"
+#include "loopback.hpp"
+#include "common/protocol.hpp"
+#include "common/socket_wrapper.hpp"
+#include "rendezvous/handover.hpp"
+#include "rendezvous/peer_snapshot.hpp"
+#include "rendezvous/rendezvous_server.hpp"
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace network {
+namespace bench {
+
+namespace {
+
+constexpr size_t PEERS = 1000000;
+constexpr auto PING_INTERVAL = std::chrono::microseconds(200);
+constexpr int RECEIVE_BUFFER = 64 * 1024 * 1024;
+
+// A full table of peers each waiting alone in its room, as after a burst of
+// registrations nobody has been paired with yet.
+void fillPeerTable(std::map<std::string, PeerInfo>& peers, std::map<std::string, std::string>& waiting) {
+    auto now = std::chrono::steady_clock::now();
+    char id[16];
+    char room[16];
+    for (size_t i = 0; i < PEERS; ++i) {
+        std::snprintf(id, sizeof(id), "peer-%07zu", i);
+        std::snprintf(room, sizeof(room), "room-%07zu", i);
+        PeerInfo peer;
+        peer.address = Endpoint("10." + std::to_string((i >> 16) & 0xff) + "." +
+                                    std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff),
+                                static_cast<uint16_t>(40000 + i % 20000));
+        peer.id = id;
+        peer.room = room;
+        peer.registered_at = now;
+        peers.emplace_hint(peers.end(), id, std::move(peer));
+        waiting.emplace_hint(waiting.end(), room, id);
+    }
+}
+
+double milliseconds(double ns) { return ns / 1e6; }
+
+// Hands a socket and a snapshot to a server starting with the listener's path, standing
+// in for a predecessor so that the server starts out with the full table.
+bool seedServer(HandoverListener& listener, const std::string& snapshot_path, SocketWrapper& socket) {
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        int successor = listener.accept();
+        if (successor >= 0) {
+            return listener.handOver(successor, socket.getFd(), snapshot_path,
+                                     RendezvousServer::HANDOVER_TIMEOUT);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+// Restart gap under load: one server with the full table hands over to a second one
+// while a client pings every PING_INTERVAL. Reports the longest silence the client saw
+// and how many pings went unanswered. The socket gets a receive buffer large enough to
+// hold the pings of the whole gap, as a deployment would size it with --rcvbuf.
+void runRestartBenchmark(Suite& suite, const std::string& directory,
+                         const std::map<std::string, PeerInfo>& peers,
+                         const std::map<std::string, std::string>& waiting) {
+    std::string handover_path = directory + "/handover.sock";
+    std::string snapshot_path = directory + "/seed.state";
+    savePeerSnapshot(snapshot_path, peers, waiting, AddressCookie());
+
+    RendezvousServerOptions options;
+    options.rate_limit = 0;
+    options.max_peers = PEERS * 2;
+    options.handover_path = handover_path;
+    options.socket.recv_buffer = RECEIVE_BUFFER;
+    options.socket.force_buffers = true;
+
+    SocketWrapper socket(SocketWrapper::Type::UDP);
+    socket.applyOptions(options.socket);
+    socket.bind("127.0.0.1", 0);
+    uint16_t port = socket.getLocalAddress().port();
+    Endpoint server("127.0.0.1", port);
+
+    auto serve = [](RendezvousServer& server, std::atomic<bool>& done) {
+        try {
+            server.run();
+        } catch (const std::exception&) {
+            // Already logged; the missing pongs show up in the results.
+        }
+        done = true;
+    };
+
+    // The fake predecessor listens before the first server starts, or it would cold start.
+    auto predecessor = std::make_unique<HandoverListener>(handover_path);
+    auto first = std::make_unique<RendezvousServer>("127.0.0.1", port, options);
+    std::atomic<bool> first_done{false};
+    std::thread first_thread([&] { serve(*first, first_done); });
+    bool seeded = seedServer(*predecessor, snapshot_path, socket);
+    predecessor.reset();
+    ::unlink(snapshot_path.c_str());
+
+    // The backlog is answered in one burst, which the client must not drop either.
+    SocketWrapper client(SocketWrapper::Type::UDP);
+    client.applyOptions(options.socket);
+    client.bind("127.0.0.1", 0);
+    client.setNonBlocking(true);
+    const std::string ping = Protocol::serialize(Command::PING);
+
+    // The first server listens for its own successor once it answers.
+    ReceivedSegments reply;
+    for (int attempt = 0; seeded && attempt < 30; ++attempt) {
+        client.sendto(ping, server);
+        if (drain(client, reply, 1) > 0) {
+            break;
+        }
+    }
+
+    RendezvousServer second("127.0.0.1", port, options);
+    std::atomic<bool> second_done{false};
+    std::thread second_thread;
+    if (seeded) {
+        second_thread = std::thread([&] { serve(second, second_done); });
+    }
+
+    // Runs until the first server has handed over and a little longer, or until either
+    // server gave up.
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    auto last_reply = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration longest_gap{0};
+    std::chrono::steady_clock::time_point settle{};
+    while (seeded && !second_done) {
+        auto now = std::chrono::steady_clock::now();
+        if (first_done && settle == std::chrono::steady_clock::time_point{}) {
+            settle = now + std::chrono::milliseconds(200);
+        }
+        if (settle != std::chrono::steady_clock::time_point{} && now >= settle) {
+            break;
+        }
+
+        client.sendto(ping, server);
+        ++sent;
+        std::this_thread::sleep_for(PING_INTERVAL);
+        while (client.tryReceiveSegmentsFrom(reply)) {
+            auto at = std::chrono::steady_clock::now();
+            longest_gap = std::max(longest_gap, at - last_reply);
+            last_reply = at;
+            received += reply.segments.size();
+        }
+    }
+    received += drain(client, reply, sent - received);
+
+    bool completed = seeded && first_done && !second_done;
+    first->stop();
+    second.stop();
+    first_thread.join();
+    if (second_thread.joinable()) {
+        second_thread.join();
+    }
+    if (!completed) {
+        throw std::runtime_error("Rendezvous handover failed in the restart benchmark");
+    }
+
+    suite.record("rendezvous.restart_gap.1m", "ms",
+                 std::chrono::duration<double, std::milli>(longest_gap).count(), Better::LOWER);
+    suite.record("rendezvous.restart_lost.1m", "datagrams", static_cast<double>(sent - received),
+                 Better::LOWER);
+}
+
+}  // namespace
+
+void runHandoverBenchmarks(Suite& suite) {
+    if (!suite.enabled("rendezvous.snapshot") && !suite.enabled("rendezvous.restart")) {
+        return;
+    }
+
+    char directory_template[] = "/tmp/p2p_bench_XXXXXX";
+    const char* directory = mkdtemp(directory_template);
+    if (directory == nullptr) {
+        throw std::runtime_error("Failed to create a temporary directory");
+    }
+    std::string path = std::string(directory) + "/peers.state";
+
+    std::map<std::string, PeerInfo> peers;
+    std::map<std::string, std::string> waiting;
+    fillPeerTable(peers, waiting);
+    AddressCookie cookie;
+
+    if (suite.enabled("rendezvous.snapshot_save.1m")) {
+        double ns = suite.measure([&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                savePeerSnapshot(path, peers, waiting, cookie);
+            }
+        });
+        suite.record("rendezvous.snapshot_save.1m", "ms", milliseconds(ns), Better::LOWER);
+    }
+
+    if (suite.enabled("rendezvous.snapshot_load.1m")) {
+        savePeerSnapshot(path, peers, waiting, cookie);
+        // Only the load is timed, not tearing down the tables afterwards.
+        double ns = suite.measure([&](size_t iterations) {
+            std::chrono::steady_clock::duration elapsed{0};
+            for (size_t i = 0; i < iterations; ++i) {
+                std::map<std::string, PeerInfo> loaded_peers;
+                std::map<std::string, std::string> loaded_waiting;
+                auto start = std::chrono::steady_clock::now();
+                loadPeerSnapshot(path, loaded_peers, loaded_waiting, cookie);
+                elapsed += std::chrono::steady_clock::now() - start;
+            }
+            return static_cast<double>(std::chrono::nanoseconds(elapsed).count());
+        });
+        suite.record("rendezvous.snapshot_load.1m", "ms", milliseconds(ns), Better::LOWER);
+    }
+    ::unlink(path.c_str());
+
+    if (suite.enabled("rendezvous.restart")) {
+        runRestartBenchmark(suite, directory, peers, waiting);
+    }
+    ::rmdir(directory);
+}
+
+}  // namespace bench
+}  // namespace network
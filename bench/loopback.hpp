@@ -0,0 +1,32 @@
+#pragma once
+
+#include "common/socket_wrapper.hpp"
+#include <poll.h>
+#include <cstddef>
+
+namespace network {
+namespace bench {
+
+// Reads from a non-blocking socket until `expected` datagrams arrived, or until it stays
+// quiet for a second because some were dropped. Returns the number received.
+inline size_t drain(SocketWrapper& socket, ReceivedSegments& received, size_t expected) {
+    size_t count = 0;
+    while (count < expected) {
+        if (socket.tryReceiveSegmentsFrom(received)) {
+            count += received.segments.size();
+            continue;
+        }
+        struct pollfd pfd{socket.getFd(), POLLIN, 0};
+        if (::poll(&pfd, 1, 1000) <= 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+inline double packetsPerSecond(double ns_per_burst, size_t burst) {
+    return static_cast<double>(burst) * 1e9 / ns_per_burst;
+}
+
+}  // namespace bench
+}  // namespace network
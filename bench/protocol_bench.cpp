@@ -0,0 +1,73 @@
+#include "bench.hpp"
+#include "common/logger.hpp"
+#include "common/protocol.hpp"
+#include <iostream>
+#include <streambuf>
+
+namespace network {
+namespace bench {
+
+namespace {
+
+// Swallows everything, so the logger benchmark times formatting rather than the terminal.
+class NullBuffer : public std::streambuf {
+   protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+}  // namespace
+
+void runProtocolBenchmarks(Suite& suite) {
+    const std::string payload = "hello from the other side of the NAT, this is message 42";
+    const std::string message = Protocol::serialize(Command::MESSAGE, payload);
+    const std::string peer_info = "203.0.113.7:40123;session=0123456789abcdef";
+    const std::string register_data = "cookie=00112233445566778899aabbccddeeff;id=client-42;room=lobby";
+
+    suite.time("protocol.serialize", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            doNotOptimize(Protocol::serialize(Command::MESSAGE, payload));
+        }
+    });
+
+    suite.time("protocol.parse", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            doNotOptimize(Protocol::parse(message));
+        }
+    });
+
+    suite.time("protocol.parse_peer_info", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            doNotOptimize(Protocol::parsePeerInfo(peer_info));
+        }
+    });
+
+    suite.time("protocol.parse_fields", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            doNotOptimize(Protocol::parseFields(register_data));
+        }
+    });
+
+    // A message below the level, the common case for the DEBUG calls on hot paths.
+    suite.time("logger.filtered", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            Logger::debug(payload);
+        }
+    });
+
+    if (suite.enabled("logger.formatted")) {
+        NullBuffer null_buffer;
+        std::streambuf* saved = std::cout.rdbuf(&null_buffer);
+        Logger::setLevel(Logger::Level::INFO);
+        suite.time("logger.formatted", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                Logger::info(payload);
+            }
+        });
+        Logger::setLevel(Logger::Level::WARNING);
+        std::cout.rdbuf(saved);
+    }
+}
+
+}  // namespace bench
+}  // namespace network
@@ -0,0 +1,131 @@
+#include "bench.hpp"
+#include "loopback.hpp"
+#include "common/protocol.hpp"
+#include "common/socket_wrapper.hpp"
+#include "rendezvous/relay_server.hpp"
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace network {
+namespace bench {
+
+namespace {
+
+constexpr size_t BURST = 64;
+const std::string SESSION = "0123456789abcdef";
+
+// Sends `message` until a reply arrives; the relay thread may not be listening yet.
+std::string request(SocketWrapper& socket, const std::string& message, uint16_t port) {
+    ReceivedSegments received;
+    for (int attempt = 0; attempt < 20; ++attempt) {
+        socket.sendto(message, Endpoint("127.0.0.1", port));
+        if (drain(socket, received, 1) > 0) {
+            return received.segments.front();
+        }
+    }
+    throw std::runtime_error("Relay did not answer " + message);
+}
+
+// Median ping-pong time between `a` and `b`; send(true) sends from `a`, send(false)
+// answers from `b`.
+template <typename Send>
+double roundTrip(Suite& suite, SocketWrapper& a, SocketWrapper& b, Send&& send) {
+    ReceivedSegments received;
+    return suite.measure([&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            send(true);
+            drain(b, received, 1);
+            send(false);
+            drain(a, received, 1);
+        }
+    });
+}
+
+}  // namespace
+
+void runRelayBenchmarks(Suite& suite) {
+    if (!suite.enabled("relay.")) {
+        return;
+    }
+
+    uint16_t control_port;
+    {
+        SocketWrapper probe(SocketWrapper::Type::UDP);
+        probe.bind("127.0.0.1", 0);
+        control_port = probe.getLocalAddress().port();
+    }
+
+    RelayServerOptions options;
+    options.rate_limit = 0;
+    RelayServer relay("127.0.0.1", control_port, options);
+    std::thread relay_thread([&relay] {
+        try {
+            relay.run();
+        } catch (const std::exception&) {
+            // Already logged; request() reports the relay as unreachable.
+        }
+    });
+
+    SocketWrapper a(SocketWrapper::Type::UDP);
+    SocketWrapper b(SocketWrapper::Type::UDP);
+    a.bind("127.0.0.1", 0);
+    b.bind("127.0.0.1", 0);
+    a.setNonBlocking(true);
+    b.setNonBlocking(true);
+    Endpoint a_address = a.getLocalAddress();
+    Endpoint b_address = b.getLocalAddress();
+
+    try {
+        std::string allocate = Protocol::serialize(Command::RELAY_ALLOCATE, "session=" + SESSION);
+        auto cookie = Protocol::parse(request(a, allocate, control_port)).second;
+        auto reply = request(a, allocate + ";cookie=" + cookie, control_port);
+        auto fields = Protocol::parseFields(Protocol::parse(reply).second);
+        if (fields["port"].empty()) {
+            throw std::runtime_error("Relay allocation failed: " + reply);
+        }
+        auto session_port = static_cast<uint16_t>(std::stoi(fields["port"]));
+        Endpoint session("127.0.0.1", session_port);
+
+        std::string bind = Protocol::serialize(Command::RELAY_BIND, "session=" + SESSION);
+        request(a, bind, session_port);
+        request(b, bind, session_port);
+        ReceivedSegments received;
+        drain(a, received, 1);  // READY once the second peer bound
+
+        const std::string payload(64, 'x');
+        if (suite.enabled("relay.rtt") || suite.enabled("relay.added_latency")) {
+            double direct = roundTrip(suite, a, b, [&](bool forth) {
+                (forth ? a : b).sendto(payload, forth ? b_address : a_address);
+            });
+            double relayed = roundTrip(suite, a, b, [&](bool forth) {
+                (forth ? a : b).sendto(payload, session);
+            });
+            suite.record("relay.rtt_direct", "ns", direct, Better::LOWER);
+            suite.record("relay.rtt_relayed", "ns", relayed, Better::LOWER);
+            suite.record("relay.added_latency", "ns", relayed - direct, Better::LOWER);
+        }
+
+        if (suite.enabled("relay.pps")) {
+            std::vector<std::string> datagrams(BURST, payload);
+            double ns = suite.measure([&](size_t iterations) {
+                for (size_t i = 0; i < iterations; ++i) {
+                    a.sendtoBatch(datagrams, session);
+                    drain(b, received, BURST);
+                }
+            });
+            suite.record("relay.pps", "pps", packetsPerSecond(ns, BURST), Better::HIGHER);
+        }
+    } catch (...) {
+        relay.stop();
+        relay_thread.join();
+        throw;
+    }
+
+    relay.stop();
+    relay_thread.join();
+}
+
+}  // namespace bench
+}  // namespace network
@@ -0,0 +1,239 @@
+#include "bench.hpp"
+#include "loopback.hpp"
+#include "common/datagram_io.hpp"
+#include "common/io_thread.hpp"
+#include "common/protocol.hpp"
+#include "common/tracing.hpp"
+#include "rendezvous/rendezvous_server.hpp"
+#include <sched.h>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace network {
+namespace bench {
+
+namespace {
+
+// Feeds pre-built datagrams to the server in one pass and counts its replies, so the
+// benchmark times the handler and not the loopback.
+class SyntheticIo : public DatagramIo {
+   public:
+    explicit SyntheticIo(std::vector<ReceivedSegments> datagrams) : datagrams_(std::move(datagrams)) {}
+
+    IoBackend backend() const override { return IoBackend::REPLAY; }
+
+    size_t poll(const DatagramHandler& handler, std::chrono::milliseconds) override {
+        size_t handled = 0;
+        for (; next_ < datagrams_.size() && handled < BATCH; ++next_, ++handled) {
+            handler(datagrams_[next_]);
+        }
+        return handled;
+    }
+
+    void sendto(const std::string&, const Endpoint&) override { ++sent_; }
+
+    bool closed() const override { return next_ >= datagrams_.size(); }
+
+    uint64_t sent() const { return sent_; }
+
+   private:
+    static constexpr size_t BATCH = 256;
+
+    std::vector<ReceivedSegments> datagrams_;
+    size_t next_ = 0;
+    uint64_t sent_ = 0;
+};
+
+// `count` registrations from distinct clients, consecutive pairs sharing a room.
+std::vector<ReceivedSegments> registrations(size_t count) {
+    std::vector<ReceivedSegments> datagrams(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& datagram = datagrams[i];
+        datagram.sender = Endpoint("10." + std::to_string((i >> 16) & 0xff) + "." +
+                                       std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff),
+                                   static_cast<uint16_t>(40000 + i % 20000));
+        datagram.segments.push_back(Protocol::createRegister(
+            "00112233445566778899aabbccddeeff", "client-" + std::to_string(i),
+            "room-" + std::to_string(i / 2)));
+    }
+    return datagrams;
+}
+
+double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+}
+
+constexpr size_t RTT_WARMUP = 1000;
+constexpr size_t RTT_SAMPLES = 20000;
+
+// Cores this process may run on.
+std::vector<int> availableCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+// Tail latency of PING -> PONG over loopback against a server running on its own
+// thread, placed as `server` says; the client thread is placed as `client` says.
+// Records the 99.9th percentile of RTT_SAMPLES round trips, the jitter a wakeup or a
+// migration adds, rather than the median the other benchmarks report.
+void runPingRttBenchmark(Suite& suite, const std::string& name, const IoThreadOptions& server,
+                         const IoThreadOptions& client) {
+    if (!suite.enabled(name)) {
+        return;
+    }
+
+    uint16_t port;
+    {
+        SocketWrapper probe(SocketWrapper::Type::UDP);
+        probe.bind("127.0.0.1", 0);
+        port = probe.getLocalAddress().port();
+    }
+
+    RendezvousServerOptions options;
+    options.rate_limit = 0;
+    options.io_thread = server;
+    RendezvousServer rendezvous("127.0.0.1", port, options);
+    std::thread server_thread([&] {
+        try {
+            rendezvous.run();
+        } catch (const std::exception&) {
+            // Already logged; the client below then fails to get an answer.
+        }
+    });
+
+    std::vector<int64_t> samples;
+    bool answered = false;
+    std::thread client_thread([&] {
+        placeCurrentThread(client, "Benchmark client");
+        SocketWrapper socket(SocketWrapper::Type::UDP);
+        socket.bind("127.0.0.1", 0);
+        socket.connect(Endpoint("127.0.0.1", port));
+        socket.setNonBlocking(true);
+        const std::string ping = Protocol::serialize(Command::PING);
+        ReceivedSegments reply;
+
+        // The server thread may not be listening yet.
+        for (int attempt = 0; attempt < 20 && !answered; ++attempt) {
+            socket.sendto(ping, Endpoint("127.0.0.1", port));
+            answered = drain(socket, reply, 1) > 0;
+        }
+        samples.reserve(RTT_SAMPLES);
+        for (size_t i = 0; answered && i < RTT_WARMUP + RTT_SAMPLES; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            socket.sendto(ping, Endpoint("127.0.0.1", port));
+            if (drain(socket, reply, 1) == 0) {
+                continue;
+            }
+            if (i >= RTT_WARMUP) {
+                samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+            }
+        }
+    });
+    client_thread.join();
+    rendezvous.stop();
+    server_thread.join();
+
+    if (!answered || samples.empty()) {
+        throw std::runtime_error("Rendezvous did not answer PING in " + name);
+    }
+    std::sort(samples.begin(), samples.end());
+    suite.record(name, "ns", static_cast<double>(samples[samples.size() * 999 / 1000]),
+                 Better::LOWER);
+}
+
+}  // namespace
+
+void runRendezvousBenchmarks(Suite& suite) {
+    RendezvousServerOptions options;
+    options.rate_limit = 0;
+    options.max_peers = 1 << 20;
+
+    // REGISTER -> REGISTER:OK for every client and PEER_INFO to both peers of each pair.
+    if (suite.enabled("rendezvous.register_match")) {
+        options.verify_cookies = false;
+        suite.time("rendezvous.register_match", [&](size_t iterations) {
+            SyntheticIo io(registrations((iterations + 1) & ~size_t{1}));
+            RendezvousServer server("127.0.0.1", 0, options);
+            auto start = std::chrono::steady_clock::now();
+            server.run(io);
+            doNotOptimize(io.sent());
+            return elapsedNs(start);
+        });
+    }
+
+    // The same with every stage of handleClient recorded, against a tracer that is
+    // never flushed.
+    if (suite.enabled("rendezvous.register_match_traced")) {
+        options.verify_cookies = false;
+        Tracer::enable("/dev/null");
+        suite.time("rendezvous.register_match_traced", [&](size_t iterations) {
+            SyntheticIo io(registrations((iterations + 1) & ~size_t{1}));
+            RendezvousServer server("127.0.0.1", 0, options);
+            auto start = std::chrono::steady_clock::now();
+            server.run(io);
+            doNotOptimize(io.sent());
+            return elapsedNs(start);
+        });
+        Tracer::disable();
+    }
+
+    // The stateless path every first contact and spoofed flood takes: a REGISTER whose
+    // cookie does not verify is answered with a fresh COOKIE.
+    if (suite.enabled("rendezvous.cookie_challenge")) {
+        options.verify_cookies = true;
+        suite.time("rendezvous.cookie_challenge", [&](size_t iterations) {
+            SyntheticIo io(registrations(iterations));
+            RendezvousServer server("127.0.0.1", 0, options);
+            auto start = std::chrono::steady_clock::now();
+            server.run(io);
+            doNotOptimize(io.sent());
+            return elapsedNs(start);
+        });
+    }
+
+    // Unpinned, then server and client each pinned to a core of their own where there
+    // are two, then with the server spinning as well. A spinning server starves a client
+    // sharing its core, so that variant needs two.
+    if (suite.enabled("rendezvous.ping_rtt")) {
+        std::vector<int> cpus = availableCpus();
+        IoThreadOptions server;
+        IoThreadOptions client;
+        runPingRttBenchmark(suite, "rendezvous.ping_rtt_p999.default", server, client);
+
+        if (!cpus.empty()) {
+            server.cpus = {cpus.front()};
+            client.cpus = {cpus.back()};
+            runPingRttBenchmark(suite, "rendezvous.ping_rtt_p999.pinned", server, client);
+        }
+
+        const std::string spinning = "rendezvous.ping_rtt_p999.pinned_busy_poll";
+        if (cpus.size() < 2) {
+            if (suite.enabled(spinning)) {
+                std::printf("%-40s skipped: %s\n", spinning.c_str(), "needs two CPUs");
+            }
+        } else {
+            server.busy_poll = true;
+            runPingRttBenchmark(suite, spinning, server, client);
+        }
+    }
+}
+
+}  // namespace bench
+}  // namespace network
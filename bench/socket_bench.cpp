@@ -0,0 +1,154 @@
+#include "bench.hpp"
+#include "loopback.hpp"
+#include "common/datagram_io.hpp"
+#include "common/io_uring_io.hpp"
+#include "common/protocol.hpp"
+#include "common/socket_wrapper.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace network {
+namespace bench {
+
+namespace {
+
+constexpr size_t BATCH = 32;
+constexpr size_t BATCH_DATAGRAM_SIZE = 1200;
+constexpr size_t BURST = 64;
+
+struct Loopback {
+    SocketWrapper sender{SocketWrapper::Type::UDP};
+    SocketWrapper receiver{SocketWrapper::Type::UDP};
+    Endpoint target;
+
+    Loopback() {
+        sender.bind("127.0.0.1", 0);
+        receiver.bind("127.0.0.1", 0);
+        target = receiver.getLocalAddress();
+    }
+};
+
+void runBatchBenchmark(Suite& suite, const std::string& name, bool segmentation) {
+    if (!suite.enabled(name)) {
+        return;
+    }
+    Loopback loopback;
+    if (segmentation) {
+        loopback.sender.setGsoSegment(static_cast<uint16_t>(BATCH_DATAGRAM_SIZE));
+        loopback.receiver.setGro(true);
+    }
+    loopback.receiver.setNonBlocking(true);
+
+    std::vector<std::string> datagrams(BATCH, std::string(BATCH_DATAGRAM_SIZE, 'x'));
+    ReceivedSegments received;
+    double ns = suite.measure([&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            loopback.sender.sendtoBatch(datagrams, loopback.target);
+            drain(loopback.receiver, received, BATCH);
+        }
+    });
+    suite.record(name, "pps", packetsPerSecond(ns, BATCH), Better::HIGHER);
+}
+
+// Cost of sending one small message to the peer, the sends alone: the receiver is drained
+// outside the timed part. `connected` fixes the destination as P2PClient does once the
+// peer is known; `gather` passes the header and the payload as two parts instead of
+// serializing the message first.
+void runSmallSendBenchmark(Suite& suite, const std::string& name, bool connected, bool gather) {
+    if (!suite.enabled(name)) {
+        return;
+    }
+    Loopback loopback;
+    if (connected) {
+        loopback.sender.connect(loopback.target);
+    }
+    loopback.receiver.setNonBlocking(true);
+
+    const std::string payload(48, 'x');
+    const std::string header = Protocol::header(Command::MESSAGE, true);
+    ReceivedSegments received;
+    double ns = suite.measure([&](size_t iterations) {
+        std::chrono::steady_clock::duration elapsed{0};
+        for (size_t i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t j = 0; j < BURST; ++j) {
+                if (gather) {
+                    loopback.sender.sendv({header, payload}, loopback.target);
+                } else {
+                    loopback.sender.sendto(Protocol::serialize(Command::MESSAGE, payload),
+                                           loopback.target);
+                }
+            }
+            elapsed += std::chrono::steady_clock::now() - start;
+            drain(loopback.receiver, received, BURST);
+        }
+        return static_cast<double>(std::chrono::nanoseconds(elapsed).count());
+    });
+    suite.record(name, "ns/op", ns / BURST, Better::LOWER);
+}
+
+// Datagrams per second through a DatagramIo backend, sent in bursts from a plain socket.
+void runBackendBenchmark(Suite& suite, IoBackend backend) {
+    std::string name = std::string("io.") + DatagramIo::backendToString(backend) + ".pps";
+    if (!suite.enabled(name)) {
+        return;
+    }
+
+    Loopback loopback;
+    std::unique_ptr<DatagramIo> io;
+    try {
+        if (backend == IoBackend::IO_URING) {
+            io = std::make_unique<IoUringIo>(loopback.receiver);
+        } else {
+            io = std::make_unique<EpollIo>(loopback.receiver);
+        }
+    } catch (const std::exception& e) {
+        std::printf("%-40s skipped: %s\n", name.c_str(), e.what());
+        return;
+    }
+
+    std::vector<std::string> datagrams(BURST, std::string(64, 'x'));
+    size_t received = 0;
+    auto handler = [&received](const ReceivedSegments& segments) {
+        received += segments.segments.size();
+    };
+
+    double ns = suite.measure([&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            loopback.sender.sendtoBatch(datagrams, loopback.target);
+            received = 0;
+            while (received < BURST && io->poll(handler, std::chrono::milliseconds(1000)) > 0) {
+            }
+        }
+    });
+    suite.record(name, "pps", packetsPerSecond(ns, BURST), Better::HIGHER);
+}
+
+}  // namespace
+
+void runSocketBenchmarks(Suite& suite) {
+    if (suite.enabled("socket.sendto_recvfrom")) {
+        Loopback loopback;
+        const std::string payload(64, 'x');
+        suite.time("socket.sendto_recvfrom", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                loopback.sender.sendto(payload, loopback.target);
+                doNotOptimize(loopback.receiver.receivefrom());
+            }
+        });
+    }
+
+    runSmallSendBenchmark(suite, "socket.send_small.unconnected", false, false);
+    runSmallSendBenchmark(suite, "socket.send_small.connected", true, false);
+    runSmallSendBenchmark(suite, "socket.send_small.connected_gather", true, true);
+
+    runBatchBenchmark(suite, "socket.batch_sendmmsg.pps", false);
+    runBatchBenchmark(suite, "socket.batch_gso.pps", true);
+
+    runBackendBenchmark(suite, IoBackend::EPOLL);
+    runBackendBenchmark(suite, IoBackend::IO_URING);
+}
+
+}  // namespace bench
+}  // namespace network
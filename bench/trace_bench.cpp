@@ -0,0 +1,30 @@
+#include "bench.hpp"
+#include "common/tracing.hpp"
+
+namespace network {
+namespace bench {
+
+// What one span costs the instrumented paths, with tracing off as in production and on.
+// Runs with a tracer that is never flushed; the ring buffer wraps.
+void runTraceBenchmarks(Suite& suite) {
+    suite.time("trace.span.disabled", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            TraceSpan span("bench", "bench");
+            doNotOptimize(span.active());
+        }
+    });
+
+    if (suite.enabled("trace.span.enabled")) {
+        Tracer::enable("/dev/null");
+        suite.time("trace.span.enabled", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                TraceSpan span("bench", "bench");
+                doNotOptimize(span.active());
+            }
+        });
+        Tracer::disable();
+    }
+}
+
+}  // namespace bench
+}  // namespace network
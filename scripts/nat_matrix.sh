@@ -0,0 +1,141 @@
+#!/usr/bin/env bash
+# Hole punching across every pair of emulated NAT types on localhost.
+#
+# For each pair the script starts a nat-emulator with two NATs in front of one
+# rendezvous server, runs TRIALS client pairs in parallel (one client behind each NAT,
+# a room per pair) and reports how many pairs connected directly and the setup time
+# percentiles of those that did. A pair's setup time is the slower of its two clients.
+#
+# Usage: scripts/nat_matrix.sh [path/to/p2p_app]
+# Environment: TRIALS (default 5), TYPES, LOSS, DELAY (ms), BINDING_TIMEOUT (ms),
+#              PORT (rendezvous port, default 9700; the relay and the emulator use the
+#              ports above it), RELAY=1 to let pairs that fail fall back to a relay,
+#              KEEP=1 to keep the per-client logs in the temporary directory.
+
+set -u
+
+BIN=${1:-build/bin/p2p_app}
+TRIALS=${TRIALS:-5}
+TYPES=${TYPES:-"full-cone restricted port-restricted symmetric"}
+LOSS=${LOSS:-0}
+DELAY=${DELAY:-0}
+BINDING_TIMEOUT=${BINDING_TIMEOUT:-30000}
+PORT=${PORT:-9700}
+RELAY=${RELAY:-0}
+
+if [ ! -x "$BIN" ]; then
+    echo "p2p_app not found at $BIN" >&2
+    exit 1
+fi
+
+WORKDIR=$(mktemp -d)
+PIDS=()
+cleanup() {
+    kill "${PIDS[@]}" 2>/dev/null
+    wait 2>/dev/null
+    if [ -n "${KEEP:-}" ]; then
+        echo "Logs kept in $WORKDIR"
+    else
+        rm -rf "$WORKDIR"
+    fi
+}
+trap cleanup EXIT
+
+"$BIN" rendezvous --address 127.0.0.1 --port "$PORT" --rate-limit 0 > "$WORKDIR/rendezvous.log" 2>&1 &
+PIDS+=($!)
+
+# The emulator stands in for every server behind NAT i on ports
+# EMULATOR_BASE + i * SERVER_COUNT + k, in the order of --servers.
+SERVERS="127.0.0.1:$PORT"
+SERVER_COUNT=1
+EMULATOR_BASE=$((PORT + 2))
+QUIT_AFTER=8
+if [ "$RELAY" = "1" ]; then
+    # Relay sessions live on ports allocated at run time, which the emulator cannot
+    # stand in for: only the allocation request crosses the emulated NAT.
+    "$BIN" relay --address 127.0.0.1 --port $((PORT + 1)) --rate-limit 0 > "$WORKDIR/relay.log" 2>&1 &
+    PIDS+=($!)
+    SERVERS="$SERVERS,127.0.0.1:$((PORT + 1))"
+    SERVER_COUNT=2
+    QUIT_AFTER=14
+fi
+sleep 0.3
+
+client_args() {
+    local gateway=$((EMULATOR_BASE + $1 * SERVER_COUNT))
+    echo "--rendezvous 127.0.0.1 --rendezvous-port $gateway"
+    if [ "$RELAY" = "1" ]; then
+        echo "--relay 127.0.0.1:$((gateway + 1))"
+    fi
+}
+
+# Prints "<path> <ms>" from a client log, "none 0" if setup never finished.
+setup_result() {
+    local line
+    line=$(grep -o "Connection setup: [a-z]* after [0-9.]* ms" "$1" | head -n 1)
+    if [ -z "$line" ]; then
+        echo "none 0"
+    else
+        echo "$line" | awk '{ print $3, $5 }'
+    fi
+}
+
+printf "%-16s %-16s %9s %9s %9s %9s %9s\n" "NAT A" "NAT B" "direct" "relayed" "p50 ms" "p90 ms" "max ms"
+
+for a in $TYPES; do
+    for b in $TYPES; do
+        # The matrix is symmetric, so each unordered pair runs once.
+        if [[ "$b" < "$a" ]]; then
+            continue
+        fi
+
+        "$BIN" nat-emulator --port "$EMULATOR_BASE" --nat "$a,$b" --servers "$SERVERS" \
+            --loss "$LOSS" --delay "$DELAY" --binding-timeout "$BINDING_TIMEOUT" \
+            > "$WORKDIR/emulator-$a-$b.log" 2>&1 &
+        EMULATOR=$!
+        sleep 0.3
+
+        CLIENTS=()
+        for t in $(seq 1 "$TRIALS"); do
+            room="$a-$b-$t"
+            for side in 0 1; do
+                # shellcheck disable=SC2046
+                (sleep "$QUIT_AFTER"; echo QUIT) | timeout $((QUIT_AFTER + 5)) "$BIN" p2p-client \
+                    $(client_args "$side") --room "$room" > "$WORKDIR/$room-$side.log" 2>&1 &
+                CLIENTS+=($!)
+            done
+        done
+        wait "${CLIENTS[@]}" 2>/dev/null
+        kill "$EMULATOR" 2>/dev/null
+        wait "$EMULATOR" 2>/dev/null
+
+        direct=0
+        relayed=0
+        : > "$WORKDIR/times"
+        for t in $(seq 1 "$TRIALS"); do
+            read -r path_a ms_a <<< "$(setup_result "$WORKDIR/$a-$b-$t-0.log")"
+            read -r path_b ms_b <<< "$(setup_result "$WORKDIR/$a-$b-$t-1.log")"
+            if [ "$path_a" = "direct" ] && [ "$path_b" = "direct" ]; then
+                direct=$((direct + 1))
+            elif [ "$path_a" != "failed" ] && [ "$path_a" != "none" ] &&
+                 [ "$path_b" != "failed" ] && [ "$path_b" != "none" ]; then
+                relayed=$((relayed + 1))
+            else
+                continue
+            fi
+            awk -v x="$ms_a" -v y="$ms_b" 'BEGIN { print (x > y ? x : y) }' >> "$WORKDIR/times"
+        done
+
+        sort -n "$WORKDIR/times" | awk -v a="$a" -v b="$b" -v d="$direct" -v r="$relayed" -v n="$TRIALS" '
+            { t[NR] = $1 }
+            END {
+                if (NR == 0) {
+                    printf "%-16s %-16s %9s %9s %9s %9s %9s\n", a, b, d "/" n, r "/" n, "-", "-", "-"
+                    exit
+                }
+                p50 = t[int(0.5 * (NR - 1) + 0.5) + 1]
+                p90 = t[int(0.9 * (NR - 1) + 0.5) + 1]
+                printf "%-16s %-16s %9s %9s %9.1f %9.1f %9.1f\n", a, b, d "/" n, r "/" n, p50, p90, t[NR]
+            }'
+    done
+done
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "endpoint.hpp"
+#include "siphash.hpp"
+
+namespace network {
+
+// Stateless return-routability cookies, as in DTLS HelloVerifyRequest: the cookie is a
+// SipHash MAC of the client's address and the current time bucket under a key that
+// never leaves the process. A client can only echo one back if it receives packets at
+// the address it claims, and the server checks it without storing anything per client.
+// Cookies stay valid for one to two buckets.
+class AddressCookie {
+   public:
+    static constexpr std::chrono::seconds BUCKET{30};
+    static constexpr size_t SIZE = 16;  // hex characters
+
+    AddressCookie() : key_(SipHash::randomKey()), start_(std::chrono::steady_clock::now()) {}
+
+    // Restores the key and bucket epoch of another instance, e.g. across a restart, so
+    // cookies it handed out stay valid.
+    AddressCookie(const SipHash::Key& key, std::chrono::steady_clock::time_point start)
+        : key_(key), start_(start) {}
+
+    const SipHash::Key& getKey() const { return key_; }
+    std::chrono::steady_clock::time_point getStart() const { return start_; }
+
+    std::string make(const Endpoint& client, std::chrono::steady_clock::time_point now) const {
+        char cookie[SIZE + 1];
+        std::snprintf(cookie, sizeof(cookie), "%016llx",
+                      static_cast<unsigned long long>(compute(client, bucket(now))));
+        return std::string(cookie, SIZE);
+    }
+
+    bool verify(const std::string& cookie, const Endpoint& client,
+                std::chrono::steady_clock::time_point now) const {
+        if (cookie.size() != SIZE) {
+            return false;
+        }
+        uint64_t current = bucket(now);
+        return matches(cookie, compute(client, current)) ||
+               (current > 0 && matches(cookie, compute(client, current - 1)));
+    }
+
+   private:
+    uint64_t bucket(std::chrono::steady_clock::time_point now) const {
+        return static_cast<uint64_t>((now - start_) / BUCKET);
+    }
+
+    uint64_t compute(const Endpoint& client, uint64_t bucket) const {
+        uint8_t input[16 + sizeof(uint16_t) + sizeof(uint64_t)];
+        size_t ip_length = client.addressSize();
+        uint16_t port = client.port();
+        std::memcpy(input, client.addressBytes(), ip_length);
+        std::memcpy(input + ip_length, &port, sizeof(port));
+        std::memcpy(input + ip_length + sizeof(port), &bucket, sizeof(bucket));
+        return SipHash::hash(key_, input, ip_length + sizeof(port) + sizeof(bucket));
+    }
+
+    static bool matches(const std::string& cookie, uint64_t expected) {
+        char hex[SIZE + 1];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(expected));
+        uint8_t diff = 0;
+        for (size_t i = 0; i < SIZE; ++i) {
+            diff |= static_cast<uint8_t>(hex[i] ^ cookie[i]);
+        }
+        return diff == 0;
+    }
+
+    SipHash::Key key_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace network
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "datagram_io.hpp"
+#include "logger.hpp"
+
+namespace network {
+
+// Capture file layout, host byte order:
+//
+//   file header    magic "P2PCAP01", uint32 version, uint32 reserved
+//   record header  uint64 timestamp (ns since the Unix epoch), 16-byte IPv6 address
+//                  (network order, IPv4 senders v4-mapped), uint16 port, uint16 reserved,
+//                  uint32 payload length
+//   payload        padded with zeros to a multiple of 8 bytes
+//
+// The file grows in zero-filled chunks, so a capture cut short by a crash ends at the
+// first all-zero record header.
+struct CaptureRecordHeader {
+    uint64_t timestamp_ns;
+    uint8_t address[16];
+    uint16_t port;
+    uint16_t reserved;
+    uint32_t length;
+};
+
+static_assert(sizeof(CaptureRecordHeader) == 32, "capture records must stay 8-byte aligned");
+
+constexpr char CAPTURE_MAGIC[8] = {'P', '2', 'P', 'C', 'A', 'P', '0', '1'};
+constexpr uint32_t CAPTURE_VERSION = 2;
+constexpr size_t CAPTURE_FILE_HEADER_SIZE = 16;
+
+// Appends datagrams to a memory-mapped capture file. Recording one datagram is a bounds
+// check and two memcpys; the file is extended (ftruncate + mremap) only once per
+// GROWTH bytes. Not thread-safe: each receive loop owns its writer.
+class CaptureWriter {
+   public:
+    static constexpr size_t GROWTH = 16 * 1024 * 1024;
+
+    explicit CaptureWriter(const std::string& path) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to create capture file " + path + ": " +
+                                     std::strerror(errno));
+        }
+
+        try {
+            reserve(CAPTURE_FILE_HEADER_SIZE);
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+        std::memcpy(map_, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        std::memcpy(map_ + sizeof(CAPTURE_MAGIC), &CAPTURE_VERSION, sizeof(CAPTURE_VERSION));
+        size_ = CAPTURE_FILE_HEADER_SIZE;
+
+        Logger::info("Capturing received datagrams to " + path);
+    }
+
+    ~CaptureWriter() {
+        if (map_ != nullptr) {
+            munmap(map_, mapped_);
+        }
+        // Drop the unused zero tail of the last chunk.
+        if (ftruncate(fd_, static_cast<off_t>(size_)) < 0) {
+            Logger::warning("Failed to trim capture file " + path_);
+        }
+        ::close(fd_);
+        Logger::info("Captured " + std::to_string(records_) + " datagrams to " + path_);
+    }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    void append(std::string_view payload, const Endpoint& sender, std::chrono::nanoseconds timestamp) {
+        CaptureRecordHeader header{};
+        header.timestamp_ns = static_cast<uint64_t>(timestamp.count());
+        std::memcpy(header.address, sender.mapped().addressBytes(), sizeof(header.address));
+        header.port = sender.port();
+        header.length = static_cast<uint32_t>(payload.size());
+
+        size_t record_size = sizeof(header) + padded(payload.size());
+        reserve(size_ + record_size);
+        std::memcpy(map_ + size_, &header, sizeof(header));
+        std::memcpy(map_ + size_ + sizeof(header), payload.data(), payload.size());
+        size_ += record_size;
+        ++records_;
+    }
+
+    uint64_t records() const { return records_; }
+
+    static size_t padded(size_t size) { return (size + 7) & ~size_t{7}; }
+
+   private:
+    void reserve(size_t size) {
+        if (size <= mapped_) {
+            return;
+        }
+        size_t target = ((size + GROWTH - 1) / GROWTH) * GROWTH;
+        if (ftruncate(fd_, static_cast<off_t>(target)) < 0) {
+            throw std::runtime_error("Failed to grow capture file: " + std::string(std::strerror(errno)));
+        }
+
+        void* map = map_ == nullptr
+                        ? mmap(nullptr, target, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0)
+                        : mremap(map_, mapped_, target, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Failed to map capture file: " + std::string(std::strerror(errno)));
+        }
+        map_ = static_cast<char*>(map);
+        mapped_ = target;
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    char* map_ = nullptr;
+    size_t mapped_ = 0;
+    size_t size_ = 0;
+    uint64_t records_ = 0;
+};
+
+// Sequential reader over a capture file, mapped read-only.
+class CaptureReader {
+   public:
+    struct Record {
+        std::chrono::nanoseconds timestamp;
+        Endpoint sender;
+        std::string_view payload;  // points into the mapping
+    };
+
+    explicit CaptureReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open capture file " + path + ": " +
+                                     std::strerror(errno));
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < CAPTURE_FILE_HEADER_SIZE) {
+            ::close(fd);
+            throw std::runtime_error("Not a capture file: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+
+        void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Failed to map capture file " + path);
+        }
+        map_ = static_cast<const char*>(map);
+
+        uint32_t version = 0;
+        std::memcpy(&version, map_ + sizeof(CAPTURE_MAGIC), sizeof(version));
+        if (std::memcmp(map_, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || version != CAPTURE_VERSION) {
+            munmap(const_cast<char*>(map_), size_);
+            throw std::runtime_error("Not a capture file: " + path);
+        }
+        offset_ = CAPTURE_FILE_HEADER_SIZE;
+    }
+
+    ~CaptureReader() { munmap(const_cast<char*>(map_), size_); }
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    // Returns false at the end of the capture, including a zero tail left by a crash.
+    bool next(Record& record) {
+        CaptureRecordHeader header{};
+        if (offset_ + sizeof(header) > size_) {
+            return false;
+        }
+        std::memcpy(&header, map_ + offset_, sizeof(header));
+        if (header.timestamp_ns == 0 && header.length == 0) {
+            return false;
+        }
+        size_t record_size = sizeof(header) + CaptureWriter::padded(header.length);
+        if (offset_ + record_size > size_) {
+            Logger::warning("Capture file ends in a truncated record");
+            return false;
+        }
+
+        record.timestamp = std::chrono::nanoseconds(header.timestamp_ns);
+        record.sender = Endpoint::fromIpv6Bytes(header.address, header.port);
+        record.payload = std::string_view(map_ + offset_ + sizeof(header), header.length);
+        offset_ += record_size;
+        return true;
+    }
+
+   private:
+    const char* map_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+};
+
+// Records every received datagram of the wrapped backend before handing it on.
+class CapturingIo : public DatagramIo {
+   public:
+    CapturingIo(std::unique_ptr<DatagramIo> inner, const std::string& path)
+        : inner_(std::move(inner)), writer_(path) {}
+
+    IoBackend backend() const override { return inner_->backend(); }
+
+    size_t poll(const DatagramHandler& handler, std::chrono::milliseconds timeout) override {
+        return inner_->poll(recording(handler), timeout);
+    }
+
+    size_t stopReceiving(const DatagramHandler& handler) override {
+        return inner_->stopReceiving(recording(handler));
+    }
+
+    void sendto(const std::string& data, const Endpoint& to) override { inner_->sendto(data, to); }
+
+    void sendv(std::initializer_list<std::string_view> parts, const Endpoint& to) override {
+        inner_->sendv(parts, to);
+    }
+
+    void sendBatch(const std::vector<std::string>& datagrams, const Endpoint& to) override {
+        inner_->sendBatch(datagrams, to);
+    }
+
+    void flush() override { inner_->flush(); }
+
+   private:
+    DatagramHandler recording(const DatagramHandler& handler) {
+        return [this, &handler](const ReceivedSegments& received) {
+            auto timestamp = received.kernel_timestamp.count() != 0
+                                 ? received.kernel_timestamp
+                                 : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::system_clock::now().time_since_epoch());
+            for (const auto& segment : received.segments) {
+                writer_.append(segment, received.sender, timestamp);
+            }
+            handler(received);
+        };
+    }
+
+    std::unique_ptr<DatagramIo> inner_;
+    CaptureWriter writer_;
+};
+
+}  // namespace network
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace network {
+
+// ChaCha20-Poly1305 AEAD (RFC 8439). The ChaCha20 keystream is generated four blocks at
+// a time with GCC vector extensions, one vector lane per block, which compiles to
+// SSE2/AVX2 on x86-64 and NEON on AArch64 without intrinsics. Poly1305 uses 44/44/42-bit
+// limbs with 128-bit products.
+class ChaCha20Poly1305 {
+   public:
+    static constexpr size_t KEY_SIZE = 32;
+    static constexpr size_t NONCE_SIZE = 12;
+    static constexpr size_t TAG_SIZE = 16;
+
+    using Key = std::array<uint8_t, KEY_SIZE>;
+    using Nonce = std::array<uint8_t, NONCE_SIZE>;
+    using Tag = std::array<uint8_t, TAG_SIZE>;
+
+    explicit ChaCha20Poly1305(const Key& key) : key_(key) {}
+
+    // Encrypts `data` in place and returns the tag over `aad` and the ciphertext.
+    Tag seal(const Nonce& nonce, uint8_t* data, size_t length, const uint8_t* aad = nullptr,
+             size_t aad_length = 0) const {
+        uint8_t poly_key[64];
+        chacha20Block(key_.data(), 0, nonce.data(), poly_key);
+        chacha20Xor(key_.data(), 1, nonce.data(), data, length);
+        Tag tag = computeTag(poly_key, aad, aad_length, data, length);
+        secureZero(poly_key, sizeof(poly_key));
+        return tag;
+    }
+
+    // Verifies the tag, then decrypts `data` in place. Nothing is decrypted on failure.
+    bool open(const Nonce& nonce, uint8_t* data, size_t length, const uint8_t* tag,
+              const uint8_t* aad = nullptr, size_t aad_length = 0) const {
+        uint8_t poly_key[64];
+        chacha20Block(key_.data(), 0, nonce.data(), poly_key);
+        Tag expected = computeTag(poly_key, aad, aad_length, data, length);
+        secureZero(poly_key, sizeof(poly_key));
+
+        uint8_t diff = 0;
+        for (size_t i = 0; i < TAG_SIZE; ++i) {
+            diff |= static_cast<uint8_t>(expected[i] ^ tag[i]);
+        }
+        if (diff != 0) {
+            return false;
+        }
+
+        chacha20Xor(key_.data(), 1, nonce.data(), data, length);
+        return true;
+    }
+
+    // HChaCha20: derives a 256-bit subkey from a key and a 128-bit input.
+    static Key hchacha20(const uint8_t* key, const uint8_t* input) {
+        uint32_t x[16];
+        x[0] = 0x61707865;
+        x[1] = 0x3320646e;
+        x[2] = 0x79622d32;
+        x[3] = 0x6b206574;
+        for (int i = 0; i < 8; ++i) {
+            x[4 + i] = load32(key + 4 * i);
+        }
+        for (int i = 0; i < 4; ++i) {
+            x[12 + i] = load32(input + 4 * i);
+        }
+        for (int round = 0; round < 10; ++round) {
+            doubleRound(x);
+        }
+
+        Key out;
+        for (int i = 0; i < 4; ++i) {
+            store32(out.data() + 4 * i, x[i]);
+            store32(out.data() + 16 + 4 * i, x[12 + i]);
+        }
+        return out;
+    }
+
+    static void chacha20Xor(const uint8_t* key, uint32_t counter, const uint8_t* nonce,
+                            uint8_t* data, size_t length) {
+        uint8_t keystream[4 * 64];
+        while (length >= sizeof(keystream)) {
+            chacha20Blocks4(key, counter, nonce, keystream);
+            xorBytes(data, keystream, sizeof(keystream));
+            counter += 4;
+            data += sizeof(keystream);
+            length -= sizeof(keystream);
+        }
+        while (length > 0) {
+            chacha20Block(key, counter++, nonce, keystream);
+            size_t chunk = length < 64 ? length : 64;
+            xorBytes(data, keystream, chunk);
+            data += chunk;
+            length -= chunk;
+        }
+    }
+
+    static void secureZero(void* data, size_t length) {
+        volatile uint8_t* p = static_cast<volatile uint8_t*>(data);
+        while (length-- > 0) {
+            *p++ = 0;
+        }
+    }
+
+   private:
+    typedef uint32_t Vec4 __attribute__((vector_size(16)));
+    __extension__ typedef unsigned __int128 Uint128;
+
+    static uint32_t load32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static void store32(uint8_t* p, uint32_t v) {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+        p[2] = static_cast<uint8_t>(v >> 16);
+        p[3] = static_cast<uint8_t>(v >> 24);
+    }
+
+    static uint64_t load64(const uint8_t* p) {
+        return static_cast<uint64_t>(load32(p)) | (static_cast<uint64_t>(load32(p + 4)) << 32);
+    }
+
+    static void store64(uint8_t* p, uint64_t v) {
+        store32(p, static_cast<uint32_t>(v));
+        store32(p + 4, static_cast<uint32_t>(v >> 32));
+    }
+
+    static void xorBytes(uint8_t* data, const uint8_t* keystream, size_t length) {
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t a, b;
+            std::memcpy(&a, data + i, 8);
+            std::memcpy(&b, keystream + i, 8);
+            a ^= b;
+            std::memcpy(data + i, &a, 8);
+        }
+        for (; i < length; ++i) {
+            data[i] ^= keystream[i];
+        }
+    }
+
+    template <typename T>
+    static T rotl(T v, int n) {
+        return (v << n) | (v >> (32 - n));
+    }
+
+    template <typename T>
+    static void quarterRound(T& a, T& b, T& c, T& d) {
+        a += b;
+        d ^= a;
+        d = rotl(d, 16);
+        c += d;
+        b ^= c;
+        b = rotl(b, 12);
+        a += b;
+        d ^= a;
+        d = rotl(d, 8);
+        c += d;
+        b ^= c;
+        b = rotl(b, 7);
+    }
+
+    template <typename T>
+    static void doubleRound(T* x) {
+        quarterRound(x[0], x[4], x[8], x[12]);
+        quarterRound(x[1], x[5], x[9], x[13]);
+        quarterRound(x[2], x[6], x[10], x[14]);
+        quarterRound(x[3], x[7], x[11], x[15]);
+        quarterRound(x[0], x[5], x[10], x[15]);
+        quarterRound(x[1], x[6], x[11], x[12]);
+        quarterRound(x[2], x[7], x[8], x[13]);
+        quarterRound(x[3], x[4], x[9], x[14]);
+    }
+
+    static void initState(uint32_t* s, const uint8_t* key, uint32_t counter,
+                          const uint8_t* nonce) {
+        s[0] = 0x61707865;
+        s[1] = 0x3320646e;
+        s[2] = 0x79622d32;
+        s[3] = 0x6b206574;
+        for (int i = 0; i < 8; ++i) {
+            s[4 + i] = load32(key + 4 * i);
+        }
+        s[12] = counter;
+        s[13] = load32(nonce);
+        s[14] = load32(nonce + 4);
+        s[15] = load32(nonce + 8);
+    }
+
+    static void chacha20Block(const uint8_t* key, uint32_t counter, const uint8_t* nonce,
+                              uint8_t* out) {
+        uint32_t s[16];
+        uint32_t x[16];
+        initState(s, key, counter, nonce);
+        std::memcpy(x, s, sizeof(s));
+        for (int round = 0; round < 10; ++round) {
+            doubleRound(x);
+        }
+        for (int i = 0; i < 16; ++i) {
+            store32(out + 4 * i, x[i] + s[i]);
+        }
+    }
+
+    // Four consecutive blocks; lane b of every vector belongs to block counter + b.
+    static void chacha20Blocks4(const uint8_t* key, uint32_t counter, const uint8_t* nonce,
+                                uint8_t* out) {
+        uint32_t s[16];
+        initState(s, key, counter, nonce);
+
+        Vec4 x[16];
+        Vec4 initial[16];
+        for (int i = 0; i < 16; ++i) {
+            initial[i] = Vec4{s[i], s[i], s[i], s[i]};
+        }
+        initial[12] += Vec4{0, 1, 2, 3};
+        std::memcpy(x, initial, sizeof(x));
+
+        for (int round = 0; round < 10; ++round) {
+            doubleRound(x);
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            x[i] += initial[i];
+        }
+        for (int block = 0; block < 4; ++block) {
+            for (int i = 0; i < 16; ++i) {
+                store32(out + 64 * block + 4 * i, x[i][block]);
+            }
+        }
+    }
+
+    class Poly1305 {
+       public:
+        explicit Poly1305(const uint8_t* key) {
+            uint64_t t0 = load64(key);
+            uint64_t t1 = load64(key + 8);
+            r_[0] = t0 & 0xffc0fffffffULL;
+            r_[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+            r_[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+            pad_[0] = load64(key + 16);
+            pad_[1] = load64(key + 24);
+        }
+
+        // Absorbs whole 16-byte blocks; a final partial block is zero-padded, which is
+        // exactly the AEAD padding rule for the aad and ciphertext sections.
+        void updatePadded(const uint8_t* data, size_t length) {
+            while (length >= 16) {
+                block(data, 1ULL << 40);
+                data += 16;
+                length -= 16;
+            }
+            if (length > 0) {
+                uint8_t last[16] = {};
+                std::memcpy(last, data, length);
+                block(last, 1ULL << 40);
+            }
+        }
+
+        void update16(const uint8_t* data) { block(data, 1ULL << 40); }
+
+        void finish(uint8_t* tag) {
+            constexpr uint64_t M44 = 0xfffffffffffULL;
+            constexpr uint64_t M42 = 0x3ffffffffffULL;
+            uint64_t h0 = h_[0], h1 = h_[1], h2 = h_[2];
+
+            uint64_t c = h1 >> 44;
+            h1 &= M44;
+            h2 += c;
+            c = h2 >> 42;
+            h2 &= M42;
+            h0 += c * 5;
+            c = h0 >> 44;
+            h0 &= M44;
+            h1 += c;
+            c = h1 >> 44;
+            h1 &= M44;
+            h2 += c;
+            c = h2 >> 42;
+            h2 &= M42;
+            h0 += c * 5;
+            c = h0 >> 44;
+            h0 &= M44;
+            h1 += c;
+
+            // h - p, selected in constant time if non-negative.
+            uint64_t g0 = h0 + 5;
+            c = g0 >> 44;
+            g0 &= M44;
+            uint64_t g1 = h1 + c;
+            c = g1 >> 44;
+            g1 &= M44;
+            uint64_t g2 = h2 + c - (1ULL << 42);
+
+            c = (g2 >> 63) - 1;
+            g0 &= c;
+            g1 &= c;
+            g2 &= c;
+            c = ~c;
+            h0 = (h0 & c) | g0;
+            h1 = (h1 & c) | g1;
+            h2 = (h2 & c) | g2;
+
+            uint64_t t0 = pad_[0];
+            uint64_t t1 = pad_[1];
+            h0 += t0 & M44;
+            c = h0 >> 44;
+            h0 &= M44;
+            h1 += (((t0 >> 44) | (t1 << 20)) & M44) + c;
+            c = h1 >> 44;
+            h1 &= M44;
+            h2 += ((t1 >> 24) & M42) + c;
+            h2 &= M42;
+
+            store64(tag, h0 | (h1 << 44));
+            store64(tag + 8, (h1 >> 20) | (h2 << 24));
+        }
+
+       private:
+        void block(const uint8_t* m, uint64_t hibit) {
+            constexpr uint64_t M44 = 0xfffffffffffULL;
+            constexpr uint64_t M42 = 0x3ffffffffffULL;
+            uint64_t r0 = r_[0], r1 = r_[1], r2 = r_[2];
+            uint64_t s1 = r1 * (5 << 2);
+            uint64_t s2 = r2 * (5 << 2);
+
+            uint64_t t0 = load64(m);
+            uint64_t t1 = load64(m + 8);
+            uint64_t h0 = h_[0] + (t0 & M44);
+            uint64_t h1 = h_[1] + (((t0 >> 44) | (t1 << 20)) & M44);
+            uint64_t h2 = h_[2] + (((t1 >> 24) & M42) | hibit);
+
+            Uint128 d0 = static_cast<Uint128>(h0) * r0 + static_cast<Uint128>(h1) * s2 +
+                         static_cast<Uint128>(h2) * s1;
+            Uint128 d1 = static_cast<Uint128>(h0) * r1 + static_cast<Uint128>(h1) * r0 +
+                         static_cast<Uint128>(h2) * s2;
+            Uint128 d2 = static_cast<Uint128>(h0) * r2 + static_cast<Uint128>(h1) * r1 +
+                         static_cast<Uint128>(h2) * r0;
+
+            uint64_t c = static_cast<uint64_t>(d0 >> 44);
+            h0 = static_cast<uint64_t>(d0) & M44;
+            d1 += c;
+            c = static_cast<uint64_t>(d1 >> 44);
+            h1 = static_cast<uint64_t>(d1) & M44;
+            d2 += c;
+            c = static_cast<uint64_t>(d2 >> 42);
+            h2 = static_cast<uint64_t>(d2) & M42;
+            h0 += c * 5;
+            c = h0 >> 44;
+            h0 &= M44;
+            h1 += c;
+
+            h_[0] = h0;
+            h_[1] = h1;
+            h_[2] = h2;
+        }
+
+        uint64_t r_[3];
+        uint64_t h_[3] = {0, 0, 0};
+        uint64_t pad_[2];
+    };
+
+    static Tag computeTag(const uint8_t* poly_key, const uint8_t* aad, size_t aad_length,
+                          const uint8_t* ciphertext, size_t length) {
+        Poly1305 mac(poly_key);
+        if (aad_length > 0) {
+            mac.updatePadded(aad, aad_length);
+        }
+        mac.updatePadded(ciphertext, length);
+
+        uint8_t lengths[16];
+        store64(lengths, aad_length);
+        store64(lengths + 8, length);
+        mac.update16(lengths);
+
+        Tag tag;
+        mac.finish(tag.data());
+        return tag;
+    }
+
+    Key key_;
+};
+
+}  // namespace network
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include "logger.hpp"
+#include "lz4.hpp"
+#include "protocol.hpp"
+
+namespace network {
+
+// Per-message LZ4 compression for the peer channel. Each side advertises what it can
+// decode in its HOLE_PUNCH capabilities ("lz4" plus "dict=<id>" when a shared dictionary
+// is loaded); a side only compresses once the peer has advertised "lz4", and only uses
+// the dictionary if both ids match. Compressed messages travel as
+//     COMPRESSED:<D|N><original length>:<lz4 block>
+// wrapping the complete serialized message. Small or incompressible messages are sent
+// unchanged.
+class MessageCompressor {
+   public:
+    static constexpr size_t MIN_COMPRESS_SIZE = 64;
+
+    explicit MessageCompressor(bool enabled = true, const std::string& dictionary = "")
+        : enabled_(enabled),
+          encoder_(dictionary),
+          decoder_(dictionary),
+          peer_supports_lz4_(false),
+          peer_has_dictionary_(false) {}
+
+    // Capability tokens for the handshake, empty when compression is disabled.
+    std::string getCapabilities() const {
+        if (!enabled_) {
+            return "";
+        }
+        std::string caps = "lz4";
+        if (encoder_.hasDictionary()) {
+            char id[9];
+            std::snprintf(id, sizeof(id), "%08x", encoder_.getDictionaryId());
+            caps += ";dict=" + std::string(id);
+        }
+        return caps;
+    }
+
+    void setPeerCapabilities(const std::string& capabilities) {
+        bool lz4 = false;
+        bool same_dictionary = false;
+
+        std::stringstream ss(capabilities);
+        std::string token;
+        while (std::getline(ss, token, ';')) {
+            if (token == "lz4") {
+                lz4 = true;
+            } else if (token.rfind("dict=", 0) == 0 && encoder_.hasDictionary()) {
+                // Arrives unauthenticated: a malformed id means no shared dictionary.
+                const char* id = token.c_str() + 5;
+                char* end = nullptr;
+                unsigned long peer_id = std::strtoul(id, &end, 16);
+                same_dictionary = token.size() > 5 && token.size() <= 13 && *end == '\0' &&
+                                  std::isxdigit(static_cast<unsigned char>(*id)) &&
+                                  peer_id == encoder_.getDictionaryId();
+            }
+        }
+
+        if (enabled_ && lz4 && !peer_supports_lz4_) {
+            Logger::info(std::string("Compression negotiated with peer") +
+                         (same_dictionary ? " (shared dictionary)" : ""));
+        }
+        peer_has_dictionary_ = same_dictionary;
+        peer_supports_lz4_ = lz4;
+    }
+
+    bool isNegotiated() const { return enabled_ && peer_supports_lz4_; }
+
+    // Whether compress() tries LZ4 on a message of `size` bytes rather than returning it.
+    bool compresses(size_t size) const { return isNegotiated() && size >= MIN_COMPRESS_SIZE; }
+
+    std::string compress(const std::string& message) {
+        if (!compresses(message.size())) {
+            return message;
+        }
+
+        bool use_dictionary = peer_has_dictionary_;
+        std::string block = encoder_.compress(message, use_dictionary);
+
+        std::string header = Protocol::serialize(Command::COMPRESSED, use_dictionary ? "D" : "N") +
+                             std::to_string(message.size()) + ":";
+        if (header.size() + block.size() >= message.size()) {
+            return message;
+        }
+        return header + block;
+    }
+
+    // Takes the data part of a COMPRESSED datagram.
+    std::optional<std::string> decompress(const std::string& data) {
+        size_t colon_pos = data.find(':');
+        if (data.size() < 2 || colon_pos == std::string::npos || (data[0] != 'D' && data[0] != 'N')) {
+            Logger::warning("Malformed compressed message");
+            return std::nullopt;
+        }
+
+        bool use_dictionary = data[0] == 'D';
+        if (use_dictionary && !decoder_.hasDictionary()) {
+            Logger::warning("Peer used a compression dictionary that is not loaded");
+            return std::nullopt;
+        }
+
+        size_t original_size = std::stoul(data.substr(1, colon_pos - 1));
+        if (original_size > MAX_MESSAGE_SIZE) {
+            Logger::warning("Compressed message too large: " + std::to_string(original_size));
+            return std::nullopt;
+        }
+
+        std::string_view block(data.data() + colon_pos + 1, data.size() - colon_pos - 1);
+        auto message = decoder_.decompress(block, original_size, use_dictionary);
+        if (!message) {
+            Logger::warning("Corrupt compressed message");
+        }
+        return message;
+    }
+
+   private:
+    static constexpr size_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+    bool enabled_;
+    Lz4Codec encoder_;  // send path only
+    Lz4Codec decoder_;  // receive path only
+    std::atomic<bool> peer_supports_lz4_;
+    std::atomic<bool> peer_has_dictionary_;
+};
+
+}  // namespace network
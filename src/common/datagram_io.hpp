@@ -0,0 +1,158 @@
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "logger.hpp"
+#include "socket_wrapper.hpp"
+
+namespace network {
+
+enum class IoBackend { EPOLL, IO_URING, REPLAY };
+
+using DatagramHandler = std::function<void(const ReceivedSegments&)>;
+
+// Event loop over a single bound UDP socket. Handlers run on the thread calling poll();
+// sendto() may be called from any thread and may be queued until the next flush().
+class DatagramIo {
+   public:
+    virtual ~DatagramIo() = default;
+
+    virtual IoBackend backend() const = 0;
+
+    // Waits up to `timeout` for traffic and dispatches every datagram that is ready.
+    // Returns the number of receive completions handled, 0 on timeout.
+    virtual size_t poll(const DatagramHandler& handler, std::chrono::milliseconds timeout) = 0;
+
+    virtual void sendto(const std::string& data, const Endpoint& to) = 0;
+
+    // Sends one datagram made of `parts`, so callers need not concatenate a header and a
+    // payload. Backends that cannot gather copy the parts together.
+    virtual void sendv(std::initializer_list<std::string_view> parts, const Endpoint& to) {
+        std::string data;
+        for (const auto& part : parts) {
+            data.append(part);
+        }
+        sendto(data, to);
+    }
+
+    // Sends a train of datagrams to one destination; backends coalesce where they can.
+    virtual void sendBatch(const std::vector<std::string>& datagrams, const Endpoint& to) {
+        for (const auto& datagram : datagrams) {
+            sendto(datagram, to);
+        }
+    }
+
+    // Pushes queued sends to the kernel. poll() also flushes after dispatching a batch.
+    virtual void flush() {}
+
+    // Stops taking datagrams off the socket and dispatches those the backend already took,
+    // so that everything else stays queued in the socket for whoever reads it next, e.g. a
+    // successor after a handover. Returns the number of receive completions handled. A
+    // backend that reads the socket only inside poll() has nothing to stop.
+    virtual size_t stopReceiving(const DatagramHandler&) { return 0; }
+
+    // True once a backend that can run dry (a capture replay) has nothing left to deliver.
+    virtual bool closed() const { return false; }
+
+    static const char* backendToString(IoBackend backend) {
+        switch (backend) {
+            case IoBackend::EPOLL:
+                return "epoll";
+            case IoBackend::IO_URING:
+                return "io_uring";
+            case IoBackend::REPLAY:
+                return "replay";
+            default:
+                return "unknown";
+        }
+    }
+
+    static IoBackend stringToBackend(const std::string& name) {
+        if (name == "epoll")
+            return IoBackend::EPOLL;
+        if (name == "io_uring" || name == "io-uring")
+            return IoBackend::IO_URING;
+        throw std::runtime_error("Invalid I/O backend: " + name);
+    }
+};
+
+class EpollIo : public DatagramIo {
+   public:
+    explicit EpollIo(SocketWrapper& socket) : socket_(socket), epoll_fd_(-1) {
+        socket_.setNonBlocking(true);
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = socket_.getFd();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_.getFd(), &event) < 0) {
+            close(epoll_fd_);
+            throw std::runtime_error("Failed to register socket with epoll");
+        }
+
+        Logger::debug("Epoll I/O backend ready on fd: " + std::to_string(socket_.getFd()));
+    }
+
+    ~EpollIo() override {
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+    }
+
+    EpollIo(const EpollIo&) = delete;
+    EpollIo& operator=(const EpollIo&) = delete;
+
+    IoBackend backend() const override { return IoBackend::EPOLL; }
+
+    size_t poll(const DatagramHandler& handler, std::chrono::milliseconds timeout) override {
+        struct epoll_event event{};
+        int ready = epoll_wait(epoll_fd_, &event, 1, static_cast<int>(timeout.count()));
+        if (ready < 0 && errno != EINTR) {
+            throw std::runtime_error("epoll_wait failed: " + std::string(std::strerror(errno)));
+        }
+        if (ready <= 0) {
+            return 0;
+        }
+
+        // Drain a bounded batch so one busy socket cannot starve the caller's loop.
+        size_t handled = 0;
+        while (handled < MAX_BATCH && socket_.tryReceiveSegmentsFrom(received_)) {
+            handler(received_);
+            ++handled;
+        }
+        return handled;
+    }
+
+    void sendto(const std::string& data, const Endpoint& to) override { socket_.sendto(data, to); }
+
+    void sendv(std::initializer_list<std::string_view> parts, const Endpoint& to) override {
+        socket_.sendv(parts, to);
+    }
+
+    void sendBatch(const std::vector<std::string>& datagrams, const Endpoint& to) override {
+        socket_.sendtoBatch(datagrams, to);
+    }
+
+   private:
+    static constexpr size_t MAX_BATCH = 256;
+
+    SocketWrapper& socket_;
+    int epoll_fd_;
+    ReceivedSegments received_;
+};
+
+}  // namespace network
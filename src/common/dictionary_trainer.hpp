@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace network {
+
+// Builds a compression dictionary from sample messages in the spirit of zstd's COVER
+// trainer: every SEGMENT_SIZE window of every sample is scored by how common its
+// K-byte substrings are across samples, the best windows are taken greedily (zeroing
+// the substrings they cover so the next pick adds new content) and concatenated with
+// the most valuable segment last, where LZ4 offsets to it are shortest.
+class DictionaryTrainer {
+   public:
+    static constexpr size_t K = 8;
+    static constexpr size_t SEGMENT_SIZE = 64;
+
+    static std::string train(const std::vector<std::string>& samples, size_t dictionary_size) {
+        std::unordered_map<uint64_t, uint32_t> frequencies;
+        for (const auto& sample : samples) {
+            // Count each substring once per sample so a single repetitive sample does not
+            // dominate the dictionary.
+            std::unordered_map<uint64_t, bool> seen;
+            for (size_t pos = 0; pos + K <= sample.size(); ++pos) {
+                uint64_t key = read64(sample.data() + pos);
+                if (!seen[key]) {
+                    seen[key] = true;
+                    ++frequencies[key];
+                }
+            }
+        }
+
+        std::vector<std::string> chosen;
+        size_t total = 0;
+
+        while (total < dictionary_size) {
+            uint64_t best_score = 0;
+            const std::string* best_sample = nullptr;
+            size_t best_pos = 0;
+
+            for (const auto& sample : samples) {
+                if (sample.size() < K) {
+                    continue;
+                }
+                size_t last_start = sample.size() > SEGMENT_SIZE ? sample.size() - SEGMENT_SIZE : 0;
+                for (size_t start = 0; start <= last_start; start += K) {
+                    uint64_t score = scoreSegment(sample, start, frequencies);
+                    if (score > best_score) {
+                        best_score = score;
+                        best_sample = &sample;
+                        best_pos = start;
+                    }
+                }
+            }
+
+            // A segment only pays for its dictionary space if its content recurs.
+            if (best_sample == nullptr || best_score < 2 * (SEGMENT_SIZE / K)) {
+                break;
+            }
+
+            size_t length = std::min(SEGMENT_SIZE, best_sample->size() - best_pos);
+            length = std::min(length, dictionary_size - total);
+            chosen.push_back(best_sample->substr(best_pos, length));
+            total += length;
+
+            for (size_t pos = best_pos; pos + K <= best_pos + length; ++pos) {
+                frequencies[read64(best_sample->data() + pos)] = 0;
+            }
+        }
+
+        std::string dictionary;
+        dictionary.reserve(total);
+        for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+            dictionary += *it;
+        }
+        return dictionary;
+    }
+
+   private:
+    static uint64_t read64(const char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint64_t scoreSegment(const std::string& sample, size_t start,
+                                 const std::unordered_map<uint64_t, uint32_t>& frequencies) {
+        uint64_t score = 0;
+        size_t end = std::min(sample.size(), start + SEGMENT_SIZE);
+        for (size_t pos = start; pos + K <= end; ++pos) {
+            auto it = frequencies.find(read64(sample.data() + pos));
+            if (it != frequencies.end() && it->second > 1) {
+                score += it->second;
+            }
+        }
+        return score;
+    }
+};
+
+}  // namespace network
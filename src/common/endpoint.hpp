@@ -0,0 +1,185 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace network {
+
+// An IPv4 or IPv6 address and port, stored as the sockaddr the kernel takes, so sending
+// to an endpoint never parses text. IPv4 endpoints are always kept as AF_INET: the
+// v4-mapped IPv6 form (::ffff:a.b.c.d) a dual-stack socket reports is converted back on
+// the way in, so one host compares equal whichever socket saw it. Trivially copyable,
+// comparable and hashable without building strings.
+class Endpoint {
+   public:
+    // Room for the largest address, for receiving straight into data().
+    static constexpr socklen_t CAPACITY = sizeof(struct sockaddr_in6);
+
+    Endpoint() { std::memset(&address_, 0, sizeof(address_)); }
+
+    // Parses a numeric IPv4 or IPv6 address, with or without brackets.
+    Endpoint(const std::string& ip, uint16_t port) : Endpoint() {
+        std::string text = ip;
+        if (text.size() >= 2 && text.front() == '[' && text.back() == ']') {
+            text = text.substr(1, text.size() - 2);
+        }
+        if (inet_pton(AF_INET, text.c_str(), &address_.v4.sin_addr) == 1) {
+            address_.v4.sin_family = AF_INET;
+            address_.v4.sin_port = htons(port);
+        } else if (inet_pton(AF_INET6, text.c_str(), &address_.v6.sin6_addr) == 1) {
+            address_.v6.sin6_family = AF_INET6;
+            address_.v6.sin6_port = htons(port);
+            *this = unmapped();
+        } else {
+            throw std::runtime_error("Invalid address: " + ip);
+        }
+    }
+
+    // Parses "a.b.c.d:port" or "[v6]:port".
+    static Endpoint parse(const std::string& text) {
+        size_t colon = text.rfind(':');
+        if (colon == std::string::npos || colon + 1 == text.size() ||
+            (text.front() != '[' && text.find(':') != colon) ||
+            (text.front() == '[' && text[colon - 1] != ']')) {
+            throw std::runtime_error("Invalid endpoint: " + text);
+        }
+        uint32_t port = 0;
+        for (size_t i = colon + 1; i < text.size(); ++i) {
+            if (text[i] < '0' || text[i] > '9' || (port = port * 10 + (text[i] - '0')) > 65535) {
+                throw std::runtime_error("Invalid endpoint: " + text);
+            }
+        }
+        return Endpoint(text.substr(0, colon), static_cast<uint16_t>(port));
+    }
+
+    // Copies an address filled in by the kernel, e.g. by recvmsg or getsockname.
+    static Endpoint fromSockaddr(const void* address, socklen_t length) {
+        Endpoint endpoint;
+        std::memcpy(&endpoint.address_, address, std::min<size_t>(length, sizeof(endpoint.address_)));
+        return endpoint.unmapped();
+    }
+
+    // From 16 network-order address bytes with IPv4 in the v4-mapped form, the fixed-size
+    // layout capture and snapshot files store; see mapped().
+    static Endpoint fromIpv6Bytes(const uint8_t* bytes, uint16_t port) {
+        struct sockaddr_in6 address{};
+        address.sin6_family = AF_INET6;
+        address.sin6_port = htons(port);
+        std::memcpy(&address.sin6_addr, bytes, sizeof(address.sin6_addr));
+        return fromSockaddr(&address, sizeof(address));
+    }
+
+    // The IPv4 form of a v4-mapped IPv6 address; other endpoints are returned unchanged.
+    Endpoint unmapped() const {
+        if (!isIpv6() || !IN6_IS_ADDR_V4MAPPED(&address_.v6.sin6_addr)) {
+            return *this;
+        }
+        Endpoint endpoint;
+        endpoint.address_.v4.sin_family = AF_INET;
+        endpoint.address_.v4.sin_port = address_.v6.sin6_port;
+        std::memcpy(&endpoint.address_.v4.sin_addr, &address_.v6.sin6_addr.s6_addr[12], 4);
+        return endpoint;
+    }
+
+    // The v4-mapped IPv6 form an AF_INET6 socket needs to reach an IPv4 endpoint.
+    Endpoint mapped() const {
+        if (!isIpv4()) {
+            return *this;
+        }
+        Endpoint endpoint;
+        endpoint.address_.v6.sin6_family = AF_INET6;
+        endpoint.address_.v6.sin6_port = address_.v4.sin_port;
+        endpoint.address_.v6.sin6_addr.s6_addr[10] = 0xff;
+        endpoint.address_.v6.sin6_addr.s6_addr[11] = 0xff;
+        std::memcpy(&endpoint.address_.v6.sin6_addr.s6_addr[12], &address_.v4.sin_addr, 4);
+        return endpoint;
+    }
+
+    sa_family_t family() const { return address_.any.sa_family; }
+    bool isIpv4() const { return family() == AF_INET; }
+    bool isIpv6() const { return family() == AF_INET6; }
+    bool empty() const { return family() == AF_UNSPEC; }
+
+    uint16_t port() const {
+        return ntohs(isIpv6() ? address_.v6.sin6_port : address_.v4.sin_port);
+    }
+
+    // Network-order address bytes: 4 for IPv4, 16 for IPv6, none when empty.
+    const uint8_t* addressBytes() const {
+        return isIpv6() ? address_.v6.sin6_addr.s6_addr
+                        : reinterpret_cast<const uint8_t*>(&address_.v4.sin_addr);
+    }
+    size_t addressSize() const { return isIpv6() ? 16 : isIpv4() ? 4 : 0; }
+
+    const struct sockaddr* data() const { return &address_.any; }
+    struct sockaddr* data() { return &address_.any; }
+    socklen_t length() const {
+        return isIpv6() ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    }
+
+    std::string ip() const {
+        if (empty()) {
+            return "";
+        }
+        char text[INET6_ADDRSTRLEN];
+        inet_ntop(family(), addressBytes(), text, sizeof(text));
+        return text;
+    }
+
+    // "a.b.c.d:port" or "[v6]:port", the form parse() accepts.
+    std::string toString() const {
+        if (empty()) {
+            return "";
+        }
+        return (isIpv6() ? "[" + ip() + "]" : ip()) + ":" + std::to_string(port());
+    }
+
+    bool operator==(const Endpoint& other) const {
+        return family() == other.family() && port() == other.port() &&
+               std::memcmp(addressBytes(), other.addressBytes(), addressSize()) == 0 &&
+               (!isIpv6() || address_.v6.sin6_scope_id == other.address_.v6.sin6_scope_id);
+    }
+    bool operator!=(const Endpoint& other) const { return !(*this == other); }
+
+    // Orders by family, then address, then port.
+    bool operator<(const Endpoint& other) const {
+        if (family() != other.family()) {
+            return family() < other.family();
+        }
+        int order = std::memcmp(addressBytes(), other.addressBytes(), addressSize());
+        return order != 0 ? order < 0 : port() < other.port();
+    }
+
+    size_t hash() const {
+        uint64_t words[2] = {0, 0};
+        std::memcpy(words, addressBytes(), addressSize());
+        uint64_t h = (words[0] ^ (words[1] * 0x9e3779b97f4a7c15ULL)) + port();
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+   private:
+    union {
+        struct sockaddr any;
+        struct sockaddr_in v4;
+        struct sockaddr_in6 v6;
+    } address_;
+};
+
+}  // namespace network
+
+template <>
+struct std::hash<network::Endpoint> {
+    size_t operator()(const network::Endpoint& endpoint) const noexcept { return endpoint.hash(); }
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "logger.hpp"
+#include "protocol.hpp"
+
+namespace network {
+
+// Splits a serialized protocol message that does not fit in one datagram into
+//     FRAGMENT:<message id, 8 hex>:<index, 4 hex>:<count, 4 hex>:<chunk>
+// The header has a fixed width, so every fragment but the last is exactly
+// max_datagram_size bytes long, which lets a fragment train go out as one GSO send.
+class MessageFragmenter {
+   public:
+    static constexpr size_t HEADER_SIZE = 28;  // "FRAGMENT:" + 8 + ':' + 4 + ':' + 4 + ':'
+    static constexpr size_t MAX_FRAGMENTS = 0xFFFF;
+    // Largest message a ReassemblyBuffer slot holds by default; a larger one would go out
+    // in full and then always be dropped by the receiver.
+    static constexpr size_t MAX_MESSAGE_SIZE = 256 * 1024;
+
+    explicit MessageFragmenter(size_t max_datagram_size) : next_message_id_(0) {
+        setMaxDatagramSize(max_datagram_size);
+    }
+
+    void setMaxDatagramSize(size_t max_datagram_size) {
+        if (max_datagram_size <= HEADER_SIZE) {
+            throw std::runtime_error("Datagram size too small for fragmentation: " +
+                                     std::to_string(max_datagram_size));
+        }
+        max_datagram_size_ = max_datagram_size;
+    }
+
+    size_t getMaxDatagramSize() const { return max_datagram_size_; }
+
+    bool needsFragmentation(const std::string& message) const {
+        return message.size() > max_datagram_size_;
+    }
+
+    std::vector<std::string> fragment(const std::string& message) {
+        if (message.size() > MAX_MESSAGE_SIZE) {
+            throw std::runtime_error("Message too large to send: " +
+                                     std::to_string(message.size()) + " bytes, limit " +
+                                     std::to_string(MAX_MESSAGE_SIZE));
+        }
+        size_t chunk_size = max_datagram_size_ - HEADER_SIZE;
+        size_t count = (message.size() + chunk_size - 1) / chunk_size;
+        if (count > MAX_FRAGMENTS) {
+            throw std::runtime_error("Message too large to fragment: " +
+                                     std::to_string(message.size()) + " bytes");
+        }
+
+        uint32_t message_id = next_message_id_++;
+        std::vector<std::string> fragments;
+        fragments.reserve(count);
+
+        char header[HEADER_SIZE + 1];
+        for (size_t index = 0; index < count; ++index) {
+            std::snprintf(header, sizeof(header), "FRAGMENT:%08x:%04x:%04x:", message_id,
+                          static_cast<unsigned>(index), static_cast<unsigned>(count));
+            size_t offset = index * chunk_size;
+            size_t length = std::min(chunk_size, message.size() - offset);
+
+            std::string fragment;
+            fragment.reserve(HEADER_SIZE + length);
+            fragment.append(header, HEADER_SIZE);
+            fragment.append(message, offset, length);
+            fragments.push_back(std::move(fragment));
+        }
+
+        return fragments;
+    }
+
+   private:
+    size_t max_datagram_size_;
+    uint32_t next_message_id_;
+};
+
+// Reassembles FRAGMENT datagrams into the original message. All storage is allocated up
+// front: a fixed number of slots, each able to hold one message of up to
+// max_message_size bytes. Incomplete messages are dropped after `timeout`, and when every
+// slot is busy the stalest one is evicted.
+class ReassemblyBuffer {
+   public:
+    explicit ReassemblyBuffer(size_t slot_count = 4,
+                              size_t max_message_size = MessageFragmenter::MAX_MESSAGE_SIZE,
+                              std::chrono::milliseconds timeout = std::chrono::seconds(2))
+        : max_message_size_(max_message_size), timeout_(timeout), slots_(slot_count) {
+        for (auto& slot : slots_) {
+            slot.data.resize(max_message_size);
+            slot.received.resize(MessageFragmenter::MAX_FRAGMENTS / 64 + 1);
+        }
+    }
+
+    // Takes the data part of a FRAGMENT datagram (everything after "FRAGMENT:") and
+    // returns the reassembled message once its last missing fragment arrives.
+    std::optional<std::string> addFragment(const std::string& data,
+                                           std::chrono::steady_clock::time_point now) {
+        constexpr size_t FIELDS_SIZE = MessageFragmenter::HEADER_SIZE - 9;
+        if (data.size() <= FIELDS_SIZE || data[8] != ':' || data[13] != ':' ||
+            data[18] != ':') {
+            Logger::warning("Malformed fragment header");
+            return std::nullopt;
+        }
+
+        uint32_t message_id = static_cast<uint32_t>(std::stoul(data.substr(0, 8), nullptr, 16));
+        size_t index = std::stoul(data.substr(9, 4), nullptr, 16);
+        size_t count = std::stoul(data.substr(14, 4), nullptr, 16);
+        const char* chunk = data.data() + FIELDS_SIZE;
+        size_t chunk_length = data.size() - FIELDS_SIZE;
+
+        if (count == 0 || index >= count) {
+            Logger::warning("Invalid fragment index " + std::to_string(index) + "/" +
+                            std::to_string(count));
+            return std::nullopt;
+        }
+
+        expire(now);
+
+        Slot& slot = findSlot(message_id, count, now);
+        if (slot.count != count) {
+            Logger::warning("Fragment count mismatch for message " + std::to_string(message_id));
+            return std::nullopt;
+        }
+        slot.last_update = now;
+
+        uint64_t bit = 1ULL << (index % 64);
+        if (slot.received[index / 64] & bit) {
+            return std::nullopt;  // duplicate
+        }
+
+        bool is_last = (index == count - 1);
+        if (!is_last) {
+            if (slot.chunk_size == 0) {
+                slot.chunk_size = chunk_length;
+            } else if (slot.chunk_size != chunk_length) {
+                Logger::warning("Inconsistent fragment size for message " +
+                                std::to_string(message_id));
+                release(slot);
+                return std::nullopt;
+            }
+        }
+
+        if (is_last && slot.chunk_size == 0 && count > 1) {
+            // Offsets are index * chunk size, unknown until a full-size fragment arrives.
+            slot.pending_last.assign(chunk, chunk_length);
+        } else if (!store(slot, index, chunk, chunk_length)) {
+            release(slot);
+            return std::nullopt;
+        }
+
+        slot.received[index / 64] |= bit;
+        ++slot.received_count;
+
+        if (!slot.pending_last.empty() && slot.chunk_size != 0) {
+            std::string last = std::move(slot.pending_last);
+            slot.pending_last.clear();
+            if (!store(slot, count - 1, last.data(), last.size())) {
+                release(slot);
+                return std::nullopt;
+            }
+        }
+
+        if (slot.received_count < slot.count) {
+            return std::nullopt;
+        }
+
+        std::string message(slot.data.data(), slot.length);
+        release(slot);
+        return message;
+    }
+
+    // Drops incomplete messages older than the timeout; returns how many were dropped.
+    size_t expire(std::chrono::steady_clock::time_point now) {
+        size_t dropped = 0;
+        for (auto& slot : slots_) {
+            if (slot.in_use && now - slot.last_update > timeout_) {
+                Logger::warning("Reassembly timeout for message " +
+                                std::to_string(slot.message_id) + " (" +
+                                std::to_string(slot.received_count) + "/" +
+                                std::to_string(slot.count) + " fragments)");
+                release(slot);
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+   private:
+    struct Slot {
+        bool in_use = false;
+        uint32_t message_id = 0;
+        size_t count = 0;
+        size_t received_count = 0;
+        size_t chunk_size = 0;
+        size_t length = 0;
+        std::chrono::steady_clock::time_point last_update;
+        std::vector<char> data;
+        std::vector<uint64_t> received;
+        std::string pending_last;
+    };
+
+    Slot& findSlot(uint32_t message_id, size_t count,
+                   std::chrono::steady_clock::time_point now) {
+        Slot* free_slot = nullptr;
+        Slot* oldest = &slots_.front();
+        for (auto& slot : slots_) {
+            if (slot.in_use && slot.message_id == message_id) {
+                return slot;
+            }
+            if (!slot.in_use && free_slot == nullptr) {
+                free_slot = &slot;
+            }
+            if (slot.last_update < oldest->last_update) {
+                oldest = &slot;
+            }
+        }
+
+        Slot& slot = free_slot ? *free_slot : *oldest;
+        if (slot.in_use) {
+            Logger::warning("Reassembly buffer full, evicting message " +
+                            std::to_string(slot.message_id));
+            release(slot);
+        }
+
+        slot.in_use = true;
+        slot.message_id = message_id;
+        slot.count = count;
+        slot.last_update = now;
+        return slot;
+    }
+
+    bool store(Slot& slot, size_t index, const char* chunk, size_t length) {
+        size_t offset = index * slot.chunk_size;
+        if (offset + length > max_message_size_) {
+            Logger::warning("Reassembled message exceeds " + std::to_string(max_message_size_) +
+                            " bytes, dropping");
+            return false;
+        }
+        std::copy(chunk, chunk + length, slot.data.begin() + static_cast<std::ptrdiff_t>(offset));
+        slot.length = std::max(slot.length, offset + length);
+        return true;
+    }
+
+    void release(Slot& slot) {
+        std::fill(slot.received.begin(),
+                  slot.received.begin() + static_cast<std::ptrdiff_t>(slot.count / 64 + 1), 0);
+        slot.in_use = false;
+        slot.count = 0;
+        slot.received_count = 0;
+        slot.chunk_size = 0;
+        slot.length = 0;
+        slot.pending_last.clear();
+    }
+
+    size_t max_message_size_;
+    std::chrono::milliseconds timeout_;
+    std::vector<Slot> slots_;
+};
+
+}  // namespace network
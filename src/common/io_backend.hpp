@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "datagram_io.hpp"
+#include "io_uring_io.hpp"
+#include "logger.hpp"
+#include "socket_wrapper.hpp"
+
+namespace network {
+
+// Builds the requested backend, falling back to epoll when io_uring is unavailable
+// (old kernel, seccomp filter, io_uring_disabled sysctl).
+inline std::unique_ptr<DatagramIo> createDatagramIo(IoBackend preferred, SocketWrapper& socket) {
+    if (preferred == IoBackend::IO_URING) {
+        try {
+            auto io = std::make_unique<IoUringIo>(socket);
+            Logger::info("Using io_uring I/O backend");
+            return io;
+        } catch (const std::exception& e) {
+            Logger::warning("io_uring unavailable (" + std::string(e.what()) +
+                            "), falling back to epoll");
+        }
+    }
+
+    auto io = std::make_unique<EpollIo>(socket);
+    Logger::info("Using epoll I/O backend");
+    return io;
+}
+
+}  // namespace network
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "logger.hpp"
+#include "socket_wrapper.hpp"
+
+namespace network {
+
+// Where and how a thread serving a socket runs. Latency-sensitive deployments pin it to
+// isolated cores, so that it is neither migrated nor queued behind unrelated work, and
+// let it spin on poll instead of sleeping, so that a datagram is picked up without the
+// tens of microseconds a wakeup costs.
+struct IoThreadOptions {
+    // SO_BUSY_POLL a spinning thread sets when SocketOptions::busy_poll_us is unset.
+    static constexpr int DEFAULT_BUSY_POLL_US = 50;
+
+    std::vector<int> cpus;   // cores the thread may run on, empty leaves it to the scheduler
+    bool busy_poll = false;  // poll without ever sleeping
+
+    // Parses a list of cores such as "2", "2,3" or "0-3,8".
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            std::string range = list.substr(start, end == std::string::npos ? end : end - start);
+            size_t dash = range.find('-');
+            try {
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                if (first < 0 || last < first || last >= CPU_SETSIZE) {
+                    throw std::out_of_range(range);
+                }
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            } catch (const std::logic_error&) {
+                throw std::runtime_error("Invalid CPU list: " + list);
+            }
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        return cpus;
+    }
+
+    static std::string cpuListToString(const std::vector<int>& cpus) {
+        std::string list;
+        for (int cpu : cpus) {
+            list += (list.empty() ? "" : ",") + std::to_string(cpu);
+        }
+        return list;
+    }
+};
+
+// Pins the calling thread to `options.cpus` and makes its later allocations come from the
+// NUMA node of the core it runs on. Owners call it before building their receive buffers,
+// io_uring rings and tables, so that those land next to the core that touches them, even
+// when the process was started under an interleave policy. Throws if the cores are not
+// available to the process.
+inline void placeCurrentThread(const IoThreadOptions& options, const std::string& name) {
+    if (options.cpus.empty()) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : options.cpus) {
+        CPU_SET(cpu, &set);
+    }
+    std::string list = IoThreadOptions::cpuListToString(options.cpus);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        throw std::runtime_error("Failed to pin " + name + " thread to CPUs " + list + ": " +
+                                 std::strerror(error));
+    }
+
+    if (syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) < 0 && errno != ENOSYS) {
+        Logger::warning("Failed to set a node-local memory policy for the " + name + " thread: " +
+                        std::strerror(errno));
+    }
+
+    unsigned cpu = 0;
+    unsigned node = 0;
+    syscall(SYS_getcpu, &cpu, &node, nullptr);
+    Logger::info(name + " thread pinned to CPUs " + list + ", running on CPU " +
+                 std::to_string(cpu) + " of NUMA node " + std::to_string(node));
+}
+
+// Gives a spinning thread's socket SO_BUSY_POLL as well, so that each receive also polls
+// the device queue, unless the socket options chose a value. Raising it needs
+// CAP_NET_ADMIN; without that the thread still spins, on the socket queue only.
+inline void enableBusyPoll(SocketWrapper& socket, const IoThreadOptions& options,
+                           const SocketOptions& socket_options) {
+    if (!options.busy_poll || socket_options.busy_poll_us > 0) {
+        return;
+    }
+    try {
+        socket.setBusyPoll(IoThreadOptions::DEFAULT_BUSY_POLL_US);
+    } catch (const std::exception& e) {
+        Logger::warning(std::string(e.what()) + ", spinning without it");
+    }
+}
+
+// Where an I/O thread's time goes: inside poll(), waiting or, when busy polling,
+// spinning, versus in the handlers it dispatches to. Written by the thread only; read it
+// from the thread itself or once the thread has finished.
+class IoThreadStats {
+   public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::chrono::seconds REPORT_INTERVAL{60};
+
+    // Counts its lifetime as processing; one per handler call.
+    class Processing {
+       public:
+        explicit Processing(IoThreadStats& stats) : stats_(stats), start_(Clock::now()) {}
+        ~Processing() { stats_.processing_in_poll_ += Clock::now() - start_; }
+
+        Processing(const Processing&) = delete;
+        Processing& operator=(const Processing&) = delete;
+
+       private:
+        IoThreadStats& stats_;
+        Clock::time_point start_;
+    };
+
+    IoThreadStats() : next_report_(Clock::now() + REPORT_INTERVAL) {}
+
+    // Times one call of `poll`, a wrapper around DatagramIo::poll() returning its result.
+    // The handlers it dispatches to set their time apart with Processing.
+    template <typename Poll>
+    size_t poll(Poll&& poll) {
+        processing_in_poll_ = Clock::duration::zero();
+        auto start = Clock::now();
+        size_t handled = poll();
+        auto elapsed = Clock::now() - start;
+
+        processing_ += processing_in_poll_;
+        polling_ += elapsed - processing_in_poll_;
+        ++polls_;
+        handled_ += handled;
+        return handled;
+    }
+
+    Clock::duration polling() const { return polling_; }
+    Clock::duration processing() const { return processing_; }
+    uint64_t polls() const { return polls_; }
+    uint64_t handled() const { return handled_; }
+
+    std::string toString() const {
+        double polling_ms = std::chrono::duration<double, std::milli>(polling_).count();
+        double processing_ms = std::chrono::duration<double, std::milli>(processing_).count();
+        double total = polling_ms + processing_ms;
+        double processing_share = total > 0 ? 100 * processing_ms / total : 0;
+        return "polling " + std::to_string(polling_ms) + " ms, processing " +
+               std::to_string(processing_ms) + " ms (" + std::to_string(processing_share) +
+               "% busy), " + std::to_string(handled_) + " receives in " +
+               std::to_string(polls_) + " polls";
+    }
+
+    // Logs the totals once every REPORT_INTERVAL.
+    void reportIfDue(const std::string& name) {
+        auto now = Clock::now();
+        if (now >= next_report_) {
+            next_report_ = now + REPORT_INTERVAL;
+            report(name);
+        }
+    }
+
+    void report(const std::string& name) const { Logger::info(name + " thread: " + toString()); }
+
+   private:
+    Clock::duration polling_{0};
+    Clock::duration processing_{0};
+    Clock::duration processing_in_poll_{0};
+    uint64_t polls_ = 0;
+    uint64_t handled_ = 0;
+    Clock::time_point next_report_;
+};
+
+}  // namespace network
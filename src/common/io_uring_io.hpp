@@ -0,0 +1,557 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "datagram_io.hpp"
+#include "logger.hpp"
+#include "socket_wrapper.hpp"
+
+namespace network {
+
+// io_uring datagram loop built directly on the kernel ABI: one multishot RECVMSG feeds a
+// provided buffer ring, so steady-state receives need no syscalls beyond the completion
+// wait, and sends are queued as SENDMSG entries submitted together by flush().
+// Requires Linux 6.0+ (multishot recvmsg, IORING_REGISTER_PBUF_RING, EXT_ARG waits).
+class IoUringIo : public DatagramIo {
+   public:
+    explicit IoUringIo(SocketWrapper& socket, unsigned queue_depth = 256)
+        : socket_(socket),
+          buffer_size_(sizeof(struct io_uring_recvmsg_out) + Endpoint::CAPACITY +
+                       SocketWrapper::RECEIVE_CONTROL_SIZE + MAX_PAYLOAD_SIZE) {
+        struct io_uring_params params{};
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring_fd_ < 0) {
+            throw std::runtime_error("io_uring_setup failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        try {
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+                !(params.features & IORING_FEAT_EXT_ARG)) {
+                throw std::runtime_error("io_uring kernel support is too old");
+            }
+            mapRings(params);
+            setupBufferRing();
+            setupSendSlots(params.sq_entries);
+            armReceive();
+            submit();
+            checkReceiveSupported();
+        } catch (...) {
+            release();
+            throw;
+        }
+
+        Logger::debug("io_uring I/O backend ready on fd: " + std::to_string(socket_.getFd()) +
+                      ", queue depth: " + std::to_string(params.sq_entries));
+    }
+
+    ~IoUringIo() override {
+        drainSends();
+        release();
+    }
+
+    IoUringIo(const IoUringIo&) = delete;
+    IoUringIo& operator=(const IoUringIo&) = delete;
+
+    IoBackend backend() const override { return IoBackend::IO_URING; }
+
+    size_t poll(const DatagramHandler& handler, std::chrono::milliseconds timeout) override {
+        if (!recv_armed_) {
+            std::lock_guard<std::mutex> lock(sq_mutex_);
+            armReceive();
+        }
+        flush();
+
+        if (!completionsReady()) {
+            waitForCompletions(timeout);
+        }
+
+        size_t handled = reapCompletions(&handler);
+        flush();
+        return handled;
+    }
+
+    void sendto(const std::string& data, const Endpoint& to) override { sendv({data}, to); }
+
+    // The parts are gathered into the slot's buffer, which has to outlive the submission.
+    void sendv(std::initializer_list<std::string_view> parts, const Endpoint& to) override {
+        // The connected peer takes no address, see SocketWrapper::connect().
+        bool connected = socket_.isConnectedTo(to);
+        Endpoint addr = connected ? Endpoint() : socket_.toNative(to);
+
+        std::unique_lock<std::mutex> lock(sq_mutex_);
+
+        struct io_uring_sqe* sqe = free_slots_.empty() ? nullptr : nextSqe();
+        if (sqe == nullptr) {
+            // Ring or slot pool is saturated; a direct syscall never waits on the poll thread.
+            lock.unlock();
+            socket_.sendv(parts, to);
+            return;
+        }
+
+        size_t index = free_slots_.back();
+        free_slots_.pop_back();
+        SendSlot& slot = send_slots_[index];
+        slot.in_use = true;
+        slot.addr = addr;
+        slot.data.clear();
+        for (const auto& part : parts) {
+            slot.data.append(part);
+        }
+        slot.iov.iov_base = slot.data.data();
+        slot.iov.iov_len = slot.data.size();
+        slot.msg = {};
+        slot.msg.msg_name = connected ? nullptr : slot.addr.data();
+        slot.msg.msg_namelen = connected ? 0 : slot.addr.length();
+        slot.msg.msg_iov = &slot.iov;
+        slot.msg.msg_iovlen = 1;
+
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = socket_.getFd();
+        sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+        sqe->len = 1;
+        sqe->user_data = static_cast<uint64_t>(index);
+        ++pending_submissions_;
+    }
+
+    void flush() override {
+        std::lock_guard<std::mutex> lock(sq_mutex_);
+        submit();
+    }
+
+    // Cancels the multishot receive and dispatches every datagram the kernel already
+    // placed in a provided buffer, up to the receive's terminal completion (the one
+    // without IORING_CQE_F_MORE): after that nothing more is taken off the socket. The
+    // next poll() arms a new receive.
+    size_t stopReceiving(const DatagramHandler& handler) override {
+        if (!recv_armed_) {
+            return 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sq_mutex_);
+            struct io_uring_sqe* sqe = nextSqe();
+            if (sqe == nullptr) {
+                throw std::runtime_error("io_uring submission queue full, cannot cancel receive");
+            }
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = RECV_USER_DATA;
+            sqe->user_data = CANCEL_USER_DATA;
+            ++pending_submissions_;
+            submit();
+        }
+
+        size_t handled = 0;
+        auto deadline = std::chrono::steady_clock::now() + CANCEL_TIMEOUT;
+        while (recv_armed_ && std::chrono::steady_clock::now() < deadline) {
+            if (!completionsReady()) {
+                waitForCompletions(std::chrono::milliseconds(10));
+            }
+            handled += reapCompletions(&handler);
+        }
+        flush();
+        if (recv_armed_) {
+            Logger::warning("io_uring receive did not stop within " +
+                            std::to_string(CANCEL_TIMEOUT.count()) + " ms");
+        }
+        return handled;
+    }
+
+   private:
+    static constexpr uint64_t RECV_USER_DATA = ~0ULL;
+    static constexpr uint64_t CANCEL_USER_DATA = ~0ULL - 1;
+    static constexpr std::chrono::milliseconds CANCEL_TIMEOUT{1000};
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    static constexpr unsigned BUFFER_COUNT = 256;  // must be a power of two
+    static constexpr size_t MAX_PAYLOAD_SIZE = 65536;  // a full datagram or GRO train
+
+    struct SendSlot {
+        struct msghdr msg;
+        struct iovec iov;
+        Endpoint addr;
+        std::string data;
+        bool in_use = false;
+    };
+
+    static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                     const void* arg, size_t arg_size) {
+        return static_cast<int>(
+            syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+    }
+
+    void mapRings(const struct io_uring_params& params) {
+        size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        ring_size_ = std::max(sq_size, cq_size);
+
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd_, IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED) {
+            ring_ = nullptr;
+            throw std::runtime_error("Failed to map io_uring rings");
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            throw std::runtime_error("Failed to map io_uring submission entries");
+        }
+        sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+        char* base = static_cast<char*>(ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+        // With a flat SQ array the index indirection is the identity mapping.
+        for (unsigned i = 0; i < sq_entries_; ++i) {
+            sq_array_[i] = i;
+        }
+        sq_local_tail_ = *sq_tail_;
+    }
+
+    void setupBufferRing() {
+        buf_ring_size_ = BUFFER_COUNT * sizeof(struct io_uring_buf);
+        void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            throw std::runtime_error("Failed to allocate io_uring buffer ring");
+        }
+        buf_ring_ = static_cast<struct io_uring_buf*>(ring);
+
+        struct io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = BUFFER_COUNT;
+        reg.bgid = BUFFER_GROUP;
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::runtime_error("Failed to register io_uring buffer ring: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        // Anonymous mapping so only the pages actually written by the kernel become resident.
+        buffers_size_ = static_cast<size_t>(BUFFER_COUNT) * buffer_size_;
+        void* buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED) {
+            throw std::runtime_error("Failed to allocate io_uring receive buffers");
+        }
+        buffers_ = static_cast<char*>(buffers);
+        for (unsigned bid = 0; bid < BUFFER_COUNT; ++bid) {
+            addBuffer(static_cast<uint16_t>(bid), bid);
+        }
+        publishBuffers(BUFFER_COUNT);
+
+        recv_msg_ = {};
+        recv_msg_.msg_namelen = Endpoint::CAPACITY;
+        recv_msg_.msg_controllen = SocketWrapper::RECEIVE_CONTROL_SIZE;
+    }
+
+    void setupSendSlots(unsigned sq_entries) {
+        send_slots_.resize(sq_entries);
+        free_slots_.reserve(sq_entries);
+        for (size_t i = sq_entries; i > 0; --i) {
+            free_slots_.push_back(i - 1);
+        }
+    }
+
+    // The ring tail shares storage with bufs[0].resv, see struct io_uring_buf_ring.
+    uint16_t* bufRingTail() {
+        return reinterpret_cast<uint16_t*>(reinterpret_cast<char*>(buf_ring_) +
+                                           offsetof(struct io_uring_buf, resv));
+    }
+
+    void addBuffer(uint16_t bid, unsigned offset) {
+        struct io_uring_buf& buf = buf_ring_[(buf_ring_tail_ + offset) & (BUFFER_COUNT - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(buffers_ + bid * buffer_size_);
+        buf.len = static_cast<uint32_t>(buffer_size_);
+        buf.bid = bid;
+    }
+
+    void publishBuffers(unsigned count) {
+        buf_ring_tail_ = static_cast<uint16_t>(buf_ring_tail_ + count);
+        __atomic_store_n(bufRingTail(), buf_ring_tail_, __ATOMIC_RELEASE);
+    }
+
+    void recycleBuffer(uint16_t bid) {
+        addBuffer(bid, 0);
+        publishBuffers(1);
+    }
+
+    struct io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head >= sq_entries_) {
+            submit();
+            head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            if (sq_local_tail_ - head >= sq_entries_) {
+                return nullptr;
+            }
+        }
+        return &sqes_[sq_local_tail_++ & sq_mask_];
+    }
+
+    void armReceive() {
+        struct io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = socket_.getFd();
+        sqe->addr = reinterpret_cast<uint64_t>(&recv_msg_);
+        sqe->len = 1;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = RECV_USER_DATA;
+        ++pending_submissions_;
+        recv_armed_ = true;
+    }
+
+    // Kernels before 6.0 accept the ring, EXT_ARG and the buffer ring but reject multishot
+    // RECVMSG. The entry is prepared inside the io_uring_enter that submits it, so the
+    // rejection is already posted when the constructor's submit() returns, and throwing
+    // here lets createDatagramIo() fall back to epoll instead of re-arming forever.
+    void checkReceiveSupported() {
+        if (!completionsReady()) {
+            return;
+        }
+        const struct io_uring_cqe& cqe = cqes_[*cq_head_ & cq_mask_];
+        if (cqe.user_data == RECV_USER_DATA && cqe.res < 0 && cqe.res != -ENOBUFS &&
+            !(cqe.flags & IORING_CQE_F_MORE)) {
+            throw std::runtime_error("io_uring multishot receive not supported: " +
+                                     std::string(std::strerror(-cqe.res)));
+        }
+    }
+
+    // Caller holds sq_mutex_.
+    void submit() {
+        if (pending_submissions_ == 0) {
+            return;
+        }
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        int submitted = enter(ring_fd_, pending_submissions_, 0, 0, nullptr, 0);
+        if (submitted < 0) {
+            if (errno == EAGAIN || errno == EBUSY || errno == EINTR) {
+                return;
+            }
+            throw std::runtime_error("io_uring_enter failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+        pending_submissions_ -= std::min(pending_submissions_, static_cast<unsigned>(submitted));
+    }
+
+    bool completionsReady() const {
+        return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    }
+
+    void waitForCompletions(std::chrono::milliseconds timeout) {
+        struct __kernel_timespec ts{};
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+        struct io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+        int result = enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                           sizeof(arg));
+        if (result < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN) {
+            throw std::runtime_error("io_uring wait failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+    }
+
+    void releaseSendSlot(uint64_t index) {
+        std::lock_guard<std::mutex> lock(sq_mutex_);
+        if (index < send_slots_.size() && send_slots_[index].in_use) {
+            send_slots_[index].in_use = false;
+            free_slots_.push_back(static_cast<size_t>(index));
+        }
+    }
+
+    size_t reapCompletions(const DatagramHandler* handler) {
+        size_t handled = 0;
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+
+            if (cqe.user_data == RECV_USER_DATA) {
+                if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    recv_armed_ = false;
+                }
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    if (cqe.res > 0 && handler != nullptr) {
+                        dispatch(bid, static_cast<size_t>(cqe.res), *handler);
+                        ++handled;
+                    }
+                    recycleBuffer(bid);
+                } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+                    Logger::warning("io_uring receive failed: " +
+                                    std::string(std::strerror(-cqe.res)));
+                }
+            } else if (cqe.user_data == CANCEL_USER_DATA) {
+                // -ENOENT or -EALREADY when the receive was already ending; its own
+                // terminal completion follows either way.
+            } else {
+                if (cqe.res < 0) {
+                    Logger::error("Failed to send data via UDP: " +
+                                  std::string(std::strerror(-cqe.res)));
+                }
+                releaseSendSlot(cqe.user_data);
+            }
+
+            ++head;
+            // Release each entry immediately so the kernel can keep posting while the
+            // handler runs.
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            if (head == tail) {
+                tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        return handled;
+    }
+
+    void dispatch(uint16_t bid, size_t length, const DatagramHandler& handler) {
+        char* buffer = buffers_ + bid * buffer_size_;
+        if (length < sizeof(struct io_uring_recvmsg_out)) {
+            return;
+        }
+
+        struct io_uring_recvmsg_out out;
+        std::memcpy(&out, buffer, sizeof(out));
+        char* name = buffer + sizeof(out);
+        char* control = name + recv_msg_.msg_namelen;
+        char* payload = control + recv_msg_.msg_controllen;
+        size_t available = length - static_cast<size_t>(payload - buffer);
+        size_t payload_length = std::min(static_cast<size_t>(out.payloadlen), available);
+
+        if (out.flags & MSG_TRUNC) {
+            Logger::warning("Truncated datagram of " + std::to_string(out.payloadlen) +
+                            " bytes");
+        }
+
+        struct msghdr control_msg{};
+        control_msg.msg_control = control;
+        control_msg.msg_controllen = out.controllen;
+
+        size_t segment_size = payload_length;
+        received_.kernel_timestamp = std::chrono::nanoseconds(0);
+        SocketWrapper::parseControlMessages(control_msg, segment_size,
+                                            received_.kernel_timestamp);
+        SocketWrapper::splitSegments(payload, payload_length, segment_size, received_.segments);
+
+        received_.sender = Endpoint::fromSockaddr(name, std::min<socklen_t>(out.namelen, Endpoint::CAPACITY));
+
+        handler(received_);
+    }
+
+    void drainSends() {
+        if (ring_fd_ < 0 || cqes_ == nullptr) {
+            return;
+        }
+        try {
+            flush();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            while (sendsInFlight() && std::chrono::steady_clock::now() < deadline) {
+                waitForCompletions(std::chrono::milliseconds(10));
+                reapCompletions(nullptr);
+            }
+        } catch (const std::exception& e) {
+            Logger::warning("Failed to drain io_uring sends: " + std::string(e.what()));
+        }
+    }
+
+    bool sendsInFlight() {
+        std::lock_guard<std::mutex> lock(sq_mutex_);
+        return free_slots_.size() != send_slots_.size();
+    }
+
+    void release() {
+        if (sqes_ != nullptr) {
+            munmap(sqes_, sqes_size_);
+            sqes_ = nullptr;
+        }
+        if (ring_ != nullptr) {
+            munmap(ring_, ring_size_);
+            ring_ = nullptr;
+        }
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+            ring_fd_ = -1;
+        }
+        // The buffer ring is unregistered implicitly when the ring fd goes away.
+        if (buf_ring_ != nullptr) {
+            munmap(buf_ring_, buf_ring_size_);
+            buf_ring_ = nullptr;
+        }
+        if (buffers_ != nullptr) {
+            munmap(buffers_, buffers_size_);
+            buffers_ = nullptr;
+        }
+    }
+
+    SocketWrapper& socket_;
+    size_t buffer_size_;
+    int ring_fd_ = -1;
+
+    void* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned pending_submissions_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    struct io_uring_cqe* cqes_ = nullptr;
+
+    struct io_uring_buf* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    uint16_t buf_ring_tail_ = 0;
+    char* buffers_ = nullptr;
+    size_t buffers_size_ = 0;
+    struct msghdr recv_msg_{};
+    bool recv_armed_ = false;
+
+    std::mutex sq_mutex_;
+    std::vector<SendSlot> send_slots_;
+    std::vector<size_t> free_slots_;
+
+    ReceivedSegments received_;
+};
+
+}  // namespace network
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -12,7 +13,16 @@ class Logger {
    public:
     enum class Level { DEBUG, INFO, WARNING, ERROR };
 
+    // Messages below this level are dropped; the default logs everything.
+    static void setLevel(Level level) { min_level_ = level; }
+
+    // Whether messages at `level` are logged, to skip formatting ones that would be dropped.
+    static bool enabled(Level level) { return level >= min_level_; }
+
     static void log(Level level, const std::string& message) {
+        if (level < min_level_) {
+            return;
+        }
         auto now = std::chrono::system_clock::now();
         auto time_t = std::chrono::system_clock::to_time_t(now);
         auto ms =
@@ -46,6 +56,8 @@ class Logger {
                 return "UNKNOWN";
         }
     }
+
+    inline static std::atomic<Level> min_level_{Level::DEBUG};
 };
 
 }  // namespace network
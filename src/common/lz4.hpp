@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace network {
+
+// In-tree LZ4 block codec (the LZ4 block format: token, literals, 16-bit offset, match
+// length) with optional prefix dictionary, equivalent to LZ4_compress_fast_usingDict /
+// LZ4_decompress_safe_usingDict. Input is staged behind the dictionary in one contiguous
+// work buffer so matches may reference dictionary bytes with ordinary offsets.
+// An instance keeps scratch state and is not thread-safe; use one per direction.
+class Lz4Codec {
+   public:
+    static constexpr size_t MAX_DICTIONARY_SIZE = 64 * 1024;  // reachable by 16-bit offsets
+
+    explicit Lz4Codec(const std::string& dictionary = "")
+        : dictionary_(dictionary.size() > MAX_DICTIONARY_SIZE
+                          ? dictionary.substr(dictionary.size() - MAX_DICTIONARY_SIZE)
+                          : dictionary),
+          dictionary_id_(computeDictionaryId(dictionary_)),
+          dictionary_table_(HASH_TABLE_SIZE, 0),
+          table_(HASH_TABLE_SIZE, 0) {
+        // Later positions overwrite earlier ones, so the closest occurrence wins.
+        for (size_t pos = 0; pos + MIN_MATCH <= dictionary_.size(); ++pos) {
+            dictionary_table_[hash(read32(dictionary_.data() + pos))] =
+                static_cast<uint32_t>(pos + 1);
+        }
+    }
+
+    bool hasDictionary() const { return !dictionary_.empty(); }
+
+    // Identifies the dictionary during negotiation; 0 means no dictionary.
+    uint32_t getDictionaryId() const { return dictionary_id_; }
+
+    static size_t maxCompressedSize(size_t input_size) { return input_size + input_size / 255 + 16; }
+
+    std::string compress(std::string_view input, bool use_dictionary = true) {
+        size_t prefix = (use_dictionary && hasDictionary()) ? dictionary_.size() : 0;
+        stage(input, prefix);
+        if (prefix != 0) {
+            std::copy(dictionary_table_.begin(), dictionary_table_.end(), table_.begin());
+        } else {
+            std::fill(table_.begin(), table_.end(), 0);
+        }
+
+        std::string out;
+        out.reserve(maxCompressedSize(input.size()));
+
+        const char* base = work_.data();
+        size_t end = work_.size();
+        size_t anchor = prefix;
+        size_t ip = prefix;
+
+        if (input.size() > MF_LIMIT) {
+            size_t match_limit = end - MF_LIMIT;
+            while (ip < match_limit) {
+                uint32_t sequence = read32(base + ip);
+                uint32_t& slot = table_[hash(sequence)];
+                size_t candidate = slot;
+                slot = static_cast<uint32_t>(ip + 1);
+
+                if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET ||
+                    read32(base + candidate - 1) != sequence) {
+                    ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                    continue;
+                }
+                size_t match = candidate - 1;
+
+                while (ip > anchor && match > 0 && base[ip - 1] == base[match - 1]) {
+                    --ip;
+                    --match;
+                }
+
+                size_t length = MIN_MATCH;
+                while (ip + length < end - LAST_LITERALS && base[match + length] == base[ip + length]) {
+                    ++length;
+                }
+
+                emitSequence(out, base + anchor, ip - anchor, ip - match, length);
+                ip += length;
+                anchor = ip;
+
+                if (ip >= 2 && ip - 2 >= prefix && ip + 2 < end) {
+                    table_[hash(read32(base + ip - 2))] = static_cast<uint32_t>(ip - 2 + 1);
+                }
+            }
+        }
+
+        emitLastLiterals(out, base + anchor, end - anchor);
+        return out;
+    }
+
+    // Returns nullopt for malformed blocks or when the output does not come out at
+    // exactly `original_size` bytes.
+    std::optional<std::string> decompress(std::string_view block, size_t original_size,
+                                          bool use_dictionary = true) {
+        size_t prefix = (use_dictionary && hasDictionary()) ? dictionary_.size() : 0;
+        work_.assign(dictionary_.data(), dictionary_.data() + prefix);
+        work_.reserve(prefix + original_size);
+        size_t limit = prefix + original_size;
+
+        const auto* ip = reinterpret_cast<const uint8_t*>(block.data());
+        const auto* ip_end = ip + block.size();
+
+        while (ip < ip_end) {
+            uint8_t token = *ip++;
+
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(ip, ip_end, literals)) {
+                return std::nullopt;
+            }
+            if (static_cast<size_t>(ip_end - ip) < literals || work_.size() + literals > limit) {
+                return std::nullopt;
+            }
+            work_.insert(work_.end(), ip, ip + literals);
+            ip += literals;
+
+            if (ip == ip_end) {
+                break;  // the last sequence carries literals only
+            }
+
+            if (ip_end - ip < 2) {
+                return std::nullopt;
+            }
+            size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > work_.size()) {
+                return std::nullopt;
+            }
+
+            size_t length = token & 15;
+            if (length == 15 && !readLength(ip, ip_end, length)) {
+                return std::nullopt;
+            }
+            length += MIN_MATCH;
+            if (work_.size() + length > limit) {
+                return std::nullopt;
+            }
+
+            // Byte-wise copy: the source may overlap the bytes being produced.
+            size_t from = work_.size() - offset;
+            for (size_t i = 0; i < length; ++i) {
+                work_.push_back(work_[from + i]);
+            }
+        }
+
+        if (work_.size() != limit) {
+            return std::nullopt;
+        }
+        return std::string(work_.data() + prefix, original_size);
+    }
+
+    static uint32_t computeDictionaryId(const std::string& dictionary) {
+        if (dictionary.empty()) {
+            return 0;
+        }
+        uint32_t hash = 2166136261u;  // FNV-1a
+        for (unsigned char c : dictionary) {
+            hash = (hash ^ c) * 16777619u;
+        }
+        return hash == 0 ? 1 : hash;
+    }
+
+   private:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t LAST_LITERALS = 5;
+    static constexpr size_t MF_LIMIT = 12;
+    static constexpr size_t MAX_OFFSET = 65535;
+    static constexpr unsigned SKIP_TRIGGER = 6;
+    static constexpr unsigned HASH_LOG = 12;
+    static constexpr size_t HASH_TABLE_SIZE = 1u << HASH_LOG;
+
+    static uint32_t read32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_LOG);
+    }
+
+    void stage(std::string_view input, size_t prefix) {
+        work_.assign(dictionary_.data(), dictionary_.data() + prefix);
+        work_.insert(work_.end(), input.begin(), input.end());
+    }
+
+    static void writeLength(std::string& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    static bool readLength(const uint8_t*& ip, const uint8_t* ip_end, size_t& length) {
+        uint8_t byte;
+        do {
+            if (ip == ip_end) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    static void emitSequence(std::string& out, const char* literals, size_t literal_length,
+                             size_t offset, size_t match_length) {
+        size_t token_pos = out.size();
+        out.push_back(0);
+        uint8_t token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+        if (literal_length >= 15) {
+            writeLength(out, literal_length - 15);
+        }
+        out.append(literals, literal_length);
+
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+
+        size_t match_code = match_length - MIN_MATCH;
+        token |= static_cast<uint8_t>(std::min<size_t>(match_code, 15));
+        if (match_code >= 15) {
+            writeLength(out, match_code - 15);
+        }
+        out[token_pos] = static_cast<char>(token);
+    }
+
+    static void emitLastLiterals(std::string& out, const char* literals, size_t length) {
+        out.push_back(static_cast<char>(std::min<size_t>(length, 15) << 4));
+        if (length >= 15) {
+            writeLength(out, length - 15);
+        }
+        out.append(literals, length);
+    }
+
+    std::string dictionary_;
+    uint32_t dictionary_id_;
+    std::vector<uint32_t> dictionary_table_;
+    std::vector<uint32_t> table_;
+    std::vector<char> work_;
+};
+
+}  // namespace network
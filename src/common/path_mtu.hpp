@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "logger.hpp"
+#include "protocol.hpp"
+
+namespace network {
+
+// Packetization-layer path MTU discovery (RFC 8899 style) over the peer's datagram path.
+// Starts from a size every IPv4/IPv6 path must carry and binary-searches upward with
+// MTU_PROBE datagrams sent with DF set; the peer answers each one with MTU_ACK:<size>.
+// A probe size counts as lost after MAX_ATTEMPTS unanswered tries, so isolated packet
+// loss does not shrink the result. Sizes are UDP payload bytes.
+class PathMtuProber {
+   public:
+    static constexpr size_t BASE_DATAGRAM_SIZE = 1200;
+    static constexpr size_t ETHERNET_DATAGRAM_SIZE = 1472;  // 1500 - IPv4 - UDP headers
+    static constexpr int MAX_ATTEMPTS = 3;
+    static constexpr size_t SEARCH_PRECISION = 8;
+
+    explicit PathMtuProber(size_t max_datagram_size = ETHERNET_DATAGRAM_SIZE,
+                           std::chrono::milliseconds probe_timeout = std::chrono::milliseconds(200))
+        : confirmed_(BASE_DATAGRAM_SIZE),
+          ceiling_(std::max(max_datagram_size, BASE_DATAGRAM_SIZE)),
+          probe_timeout_(probe_timeout),
+          in_flight_(0),
+          attempts_(0) {}
+
+    bool done() const { return ceiling_ - confirmed_ < SEARCH_PRECISION; }
+
+    size_t getDatagramSize() const { return confirmed_; }
+
+    // Returns the probe size to send now, or 0 if a probe is still in flight or the
+    // search has converged.
+    size_t nextProbe(std::chrono::steady_clock::time_point now) {
+        if (done()) {
+            return 0;
+        }
+
+        if (in_flight_ != 0) {
+            if (now - sent_at_ < probe_timeout_) {
+                return 0;
+            }
+            if (attempts_ >= MAX_ATTEMPTS) {
+                Logger::debug("MTU probe of " + std::to_string(in_flight_) + " bytes lost");
+                onProbeFailed(in_flight_);
+                if (done()) {
+                    return 0;
+                }
+            }
+        }
+
+        if (in_flight_ == 0) {
+            in_flight_ = confirmed_ + (ceiling_ - confirmed_ + 1) / 2;
+            attempts_ = 0;
+        }
+
+        ++attempts_;
+        sent_at_ = now;
+        return in_flight_;
+    }
+
+    void onAck(size_t size) {
+        if (size <= confirmed_) {
+            return;
+        }
+        confirmed_ = std::min(size, ceiling_);
+        if (size >= in_flight_) {
+            in_flight_ = 0;
+        }
+        if (done()) {
+            Logger::info("Path MTU discovery complete: " + std::to_string(confirmed_) +
+                         " byte datagrams");
+        }
+    }
+
+    // Called for probes that were lost or rejected locally (EMSGSIZE).
+    void onProbeFailed(size_t size) {
+        if (size <= confirmed_) {
+            return;
+        }
+        ceiling_ = std::min(ceiling_, size - 1);
+        if (size == in_flight_) {
+            in_flight_ = 0;
+        }
+        if (done()) {
+            Logger::info("Path MTU discovery complete: " + std::to_string(confirmed_) +
+                         " byte datagrams");
+        }
+    }
+
+    // Builds an MTU_PROBE message that makes a datagram of exactly `size` bytes once
+    // `overhead` bytes of outer framing (encryption) are added around it.
+    static std::string createProbe(size_t size, size_t overhead = 0) {
+        std::string probe = Protocol::serialize(Command::MTU_PROBE, std::to_string(size) + ":");
+        if (probe.size() + overhead < size) {
+            probe.append(size - overhead - probe.size(), '.');
+        }
+        return probe;
+    }
+
+   private:
+    size_t confirmed_;
+    size_t ceiling_;
+    std::chrono::milliseconds probe_timeout_;
+    size_t in_flight_;
+    int attempts_;
+    std::chrono::steady_clock::time_point sent_at_;
+};
+
+}  // namespace network
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <map>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 
+#include "endpoint.hpp"
+
 namespace network {
 
 enum class Command {
     REGISTER,
+    COOKIE,
     PEER_INFO,
     HOLE_PUNCH,
     MESSAGE,
@@ -15,6 +20,16 @@ enum class Command {
     PING,
     PONG,
     QUIT,
+    FRAGMENT,
+    MTU_PROBE,
+    MTU_ACK,
+    COMPRESSED,
+    SEALED,
+    CLUSTER_HEARTBEAT,
+    CLUSTER_REGISTER,
+    CLUSTER_PEER_INFO,
+    RELAY_ALLOCATE,
+    RELAY_BIND,
     ERROR,
     UNKNOWN
 };
@@ -30,6 +45,16 @@ class Protocol {
         return ss.str();
     }
 
+    // What serialize(cmd, data) puts before the data, for senders that gather the header
+    // and the data instead of concatenating them.
+    static std::string header(Command cmd, bool has_data) {
+        std::string header = commandToString(cmd);
+        if (has_data) {
+            header += ':';
+        }
+        return header;
+    }
+
     static std::pair<Command, std::string> parse(const std::string& message) {
         size_t colon_pos = message.find(':');
 
@@ -58,22 +83,76 @@ class Protocol {
         return serialize(Command::ERROR, error_msg);
     }
 
-    static std::string createPeerInfo(const std::string& peer_ip, uint16_t peer_port) {
-        std::stringstream ss;
-        ss << peer_ip << ":" << peer_port;
-        return serialize(Command::PEER_INFO, ss.str());
+    // First contact, REGISTER:pad=000..., padded to COOKIE_REQUEST_SIZE so that it is no
+    // smaller than the COOKIE answering it: spoofed requests cannot be amplified.
+    static constexpr size_t COOKIE_REQUEST_SIZE = 32;
+    static std::string createCookieRequest() {
+        std::string request = serialize(Command::REGISTER, "pad=");
+        request.resize(COOKIE_REQUEST_SIZE, '0');
+        return request;
     }
 
-    static std::pair<std::string, uint16_t> parsePeerInfo(const std::string& data) {
-        size_t colon_pos = data.find(':');
-        if (colon_pos == std::string::npos) {
-            throw std::runtime_error("Invalid peer info format");
+    // REGISTER:cookie=<cookie>[;id=<client id>][;room=<room>], sent in reply to the
+    // server's COOKIE. Only peers in the same room are matched.
+    static std::string createRegister(const std::string& cookie, const std::string& client_id = "",
+                                      const std::string& room = "") {
+        std::string data = "cookie=" + cookie;
+        if (!client_id.empty()) {
+            data += ";id=" + client_id;
+        }
+        if (!room.empty()) {
+            data += ";room=" + room;
+        }
+        return serialize(Command::REGISTER, data);
+    }
+
+    // Parses "key=value;key=value" message data. Tokens without '=' map to empty values.
+    static std::map<std::string, std::string> parseFields(const std::string& data) {
+        std::map<std::string, std::string> fields;
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find(';', start);
+            if (end == std::string::npos) {
+                end = data.size();
+            }
+            size_t equals = data.find('=', start);
+            if (equals != std::string::npos && equals < end) {
+                fields[data.substr(start, equals - start)] = data.substr(equals + 1, end - equals - 1);
+            } else if (end > start) {
+                fields[data.substr(start, end - start)] = "";
+            }
+            start = end + 1;
         }
+        return fields;
+    }
 
-        std::string ip = data.substr(0, colon_pos);
-        uint16_t port = static_cast<uint16_t>(std::stoi(data.substr(colon_pos + 1)));
+    // PEER_INFO:<ip>:<port>[;session=<id>], with an IPv6 address in brackets. The
+    // session id is shared by both peers of a match and names their pair at a relay if
+    // hole punching fails.
+    static std::string createPeerInfo(const Endpoint& peer, const std::string& session = "") {
+        std::string data = peer.toString();
+        if (!session.empty()) {
+            data += ";session=" + session;
+        }
+        return serialize(Command::PEER_INFO, data);
+    }
 
-        return {ip, port};
+    // Parses the "<ip>:<port>" that starts PEER_INFO data, or any other endpoint field.
+    static Endpoint parsePeerInfo(const std::string& data) {
+        size_t end = data.find(';');
+        try {
+            return Endpoint::parse(data.substr(0, end));
+        } catch (const std::runtime_error&) {
+            throw std::runtime_error("Invalid peer info format");
+        }
+    }
+
+    static std::string parsePeerSession(const std::string& data) {
+        size_t separator = data.find(';');
+        if (separator == std::string::npos) {
+            return "";
+        }
+        return parseFields(data.substr(separator + 1))["session"];
     }
 
    private:
@@ -81,6 +160,8 @@ class Protocol {
         switch (cmd) {
             case Command::REGISTER:
                 return "REGISTER";
+            case Command::COOKIE:
+                return "COOKIE";
             case Command::PEER_INFO:
                 return "PEER_INFO";
             case Command::HOLE_PUNCH:
@@ -95,6 +176,26 @@ class Protocol {
                 return "PONG";
             case Command::QUIT:
                 return "QUIT";
+            case Command::FRAGMENT:
+                return "FRAGMENT";
+            case Command::MTU_PROBE:
+                return "MTU_PROBE";
+            case Command::MTU_ACK:
+                return "MTU_ACK";
+            case Command::COMPRESSED:
+                return "COMPRESSED";
+            case Command::SEALED:
+                return "SEALED";
+            case Command::CLUSTER_HEARTBEAT:
+                return "CLUSTER_HEARTBEAT";
+            case Command::CLUSTER_REGISTER:
+                return "CLUSTER_REGISTER";
+            case Command::CLUSTER_PEER_INFO:
+                return "CLUSTER_PEER_INFO";
+            case Command::RELAY_ALLOCATE:
+                return "RELAY_ALLOCATE";
+            case Command::RELAY_BIND:
+                return "RELAY_BIND";
             case Command::ERROR:
                 return "ERROR";
             default:
@@ -105,6 +206,8 @@ class Protocol {
     static Command stringToCommand(const std::string& cmd_str) {
         if (cmd_str == "REGISTER")
             return Command::REGISTER;
+        if (cmd_str == "COOKIE")
+            return Command::COOKIE;
         if (cmd_str == "PEER_INFO")
             return Command::PEER_INFO;
         if (cmd_str == "HOLE_PUNCH")
@@ -119,6 +222,26 @@ class Protocol {
             return Command::PONG;
         if (cmd_str == "QUIT")
             return Command::QUIT;
+        if (cmd_str == "FRAGMENT")
+            return Command::FRAGMENT;
+        if (cmd_str == "MTU_PROBE")
+            return Command::MTU_PROBE;
+        if (cmd_str == "MTU_ACK")
+            return Command::MTU_ACK;
+        if (cmd_str == "COMPRESSED")
+            return Command::COMPRESSED;
+        if (cmd_str == "SEALED")
+            return Command::SEALED;
+        if (cmd_str == "CLUSTER_HEARTBEAT")
+            return Command::CLUSTER_HEARTBEAT;
+        if (cmd_str == "CLUSTER_REGISTER")
+            return Command::CLUSTER_REGISTER;
+        if (cmd_str == "CLUSTER_PEER_INFO")
+            return Command::CLUSTER_PEER_INFO;
+        if (cmd_str == "RELAY_ALLOCATE")
+            return Command::RELAY_ALLOCATE;
+        if (cmd_str == "RELAY_BIND")
+            return Command::RELAY_BIND;
         if (cmd_str == "ERROR")
             return Command::ERROR;
         return Command::UNKNOWN;
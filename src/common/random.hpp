@@ -0,0 +1,29 @@
+#pragma once
+
+#include <sys/random.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace network {
+
+// Fills `data` from the kernel CSPRNG; blocks only until the pool is initialized at boot.
+inline void fillRandom(void* data, size_t size) {
+    auto* out = static_cast<unsigned char*>(data);
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t result = getrandom(out + filled, size - filled, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("getrandom failed: " + std::string(std::strerror(errno)));
+        }
+        filled += static_cast<size_t>(result);
+    }
+}
+
+}  // namespace network
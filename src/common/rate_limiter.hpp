@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "endpoint.hpp"
+#include "siphash.hpp"
+
+namespace network {
+
+// Per-source token buckets in a fixed-size table. Sources are hashed with a secret
+// SipHash key (so an attacker cannot aim collisions at one bucket group) into groups of
+// four 16-byte entries, one cache line each. A source lives in the single group its hash
+// selects; when the group is full, the entry idle the longest is recycled, which only
+// ever errs towards admitting traffic. Memory and per-packet work stay constant no
+// matter how many addresses a flood spoofs.
+class RateLimiter {
+   public:
+    // `rate` tokens per second refill buckets holding up to `burst`; rate 0 disables.
+    RateLimiter(uint32_t rate, uint32_t burst, size_t capacity = 16384)
+        : rate_milli_per_ms_(rate),
+          burst_milli_(burst * 1000),
+          key_(SipHash::randomKey()),
+          start_(std::chrono::steady_clock::now()) {
+        size_t group_count = 1;
+        while (group_count * GROUP_SIZE < capacity) {
+            group_count <<= 1;
+        }
+        groups_.resize(group_count);
+        group_mask_ = group_count - 1;
+    }
+
+    bool enabled() const { return rate_milli_per_ms_ != 0; }
+
+    // Charges one token to the source address of `source` (its port is ignored); false
+    // means the packet should be dropped. An IPv6 source is charged per /64, since any
+    // one host is usually handed a whole /64 to pick addresses from.
+    bool allow(const Endpoint& source, std::chrono::steady_clock::time_point now) {
+        if (!enabled()) {
+            return true;
+        }
+
+        size_t prefix = source.isIpv6() ? 8 : source.addressSize();
+        uint64_t hash = SipHash::hash(key_, source.addressBytes(), prefix);
+        uint64_t tag = hash | 1;  // 0 marks a free entry
+        Group& group = groups_[(hash >> 32) & group_mask_];
+        uint32_t now_ms = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - start_).count());
+
+        Entry* entry = nullptr;
+        Entry* victim = &group.entries[0];
+        for (auto& candidate : group.entries) {
+            if (candidate.tag == tag) {
+                entry = &candidate;
+                break;
+            }
+            if (victim->tag != 0 &&
+                (candidate.tag == 0 || now_ms - candidate.last_ms > now_ms - victim->last_ms)) {
+                victim = &candidate;
+            }
+        }
+
+        if (entry == nullptr) {
+            victim->tag = tag;
+            victim->tokens_milli = burst_milli_;
+            victim->last_ms = now_ms;
+            entry = victim;
+        } else {
+            uint64_t refill =
+                static_cast<uint64_t>(now_ms - entry->last_ms) * rate_milli_per_ms_;
+            uint64_t tokens = entry->tokens_milli + refill;
+            entry->tokens_milli = static_cast<uint32_t>(tokens < burst_milli_ ? tokens : burst_milli_);
+            entry->last_ms = now_ms;
+        }
+
+        if (entry->tokens_milli < 1000) {
+            return false;
+        }
+        entry->tokens_milli -= 1000;
+        return true;
+    }
+
+   private:
+    static constexpr size_t GROUP_SIZE = 4;
+
+    // Token counts are kept in thousandths, so `rate` tokens/s is `rate` per millisecond.
+    struct Entry {
+        uint64_t tag = 0;
+        uint32_t tokens_milli = 0;
+        uint32_t last_ms = 0;
+    };
+
+    struct alignas(64) Group {
+        Entry entries[GROUP_SIZE];
+    };
+
+    uint32_t rate_milli_per_ms_;
+    uint32_t burst_milli_;
+    SipHash::Key key_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<Group> groups_;
+    size_t group_mask_;
+};
+
+}  // namespace network
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "capture.hpp"
+#include "datagram_io.hpp"
+
+namespace network {
+
+// DatagramIo without a socket: hands the datagrams of a capture file to the handler and
+// discards everything sent. With `speed` > 0 datagrams keep their recorded spacing
+// divided by `speed`; with 0 they are delivered as fast as the handler returns. The
+// whole capture is decoded up front so that only the handler is timed.
+class ReplayIo : public DatagramIo {
+   public:
+    ReplayIo(const std::string& path, double speed) : speed_(speed) {
+        CaptureReader reader(path);
+        CaptureReader::Record record;
+        while (reader.next(record)) {
+            Entry entry;
+            entry.timestamp = record.timestamp;
+            entry.received.segments.emplace_back(record.payload);
+            entry.received.sender = record.sender;
+            entries_.push_back(std::move(entry));
+        }
+        handler_ns_.reserve(entries_.size());
+        Logger::info("Loaded " + std::to_string(entries_.size()) + " datagrams from " + path);
+    }
+
+    IoBackend backend() const override { return IoBackend::REPLAY; }
+
+    size_t poll(const DatagramHandler& handler, std::chrono::milliseconds timeout) override {
+        auto now = std::chrono::steady_clock::now();
+        if (!started_) {
+            start_ = now;
+            started_ = true;
+        }
+        auto deadline = now + timeout;
+
+        size_t handled = 0;
+        while (handled < MAX_BATCH && next_ < entries_.size()) {
+            if (speed_ > 0) {
+                auto due = start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                        std::chrono::duration<double, std::nano>(
+                                            entries_[next_].timestamp - entries_.front().timestamp) /
+                                        speed_);
+                if (due > std::chrono::steady_clock::now()) {
+                    if (handled > 0) {
+                        break;
+                    }
+                    if (due > deadline) {
+                        std::this_thread::sleep_until(deadline);
+                        return 0;
+                    }
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+            handler(entries_[next_].received);
+            handler_ns_.push_back((std::chrono::steady_clock::now() - begin).count());
+            ++next_;
+            ++handled;
+        }
+        return handled;
+    }
+
+    void sendto(const std::string& data, const Endpoint&) override {
+        ++sent_datagrams_;
+        sent_bytes_ += data.size();
+    }
+
+    bool closed() const override { return next_ >= entries_.size(); }
+
+    size_t size() const { return entries_.size(); }
+    size_t delivered() const { return next_; }
+    uint64_t sentDatagrams() const { return sent_datagrams_; }
+    uint64_t sentBytes() const { return sent_bytes_; }
+
+    // Wall-clock time spent in the handler for each delivered datagram, in nanoseconds.
+    const std::vector<int64_t>& handlerTimes() const { return handler_ns_; }
+
+    // Sender of the first datagram, the peer when replaying a P2P client capture.
+    Endpoint firstSender() const {
+        return entries_.empty() ? Endpoint() : entries_.front().received.sender;
+    }
+
+   private:
+    static constexpr size_t MAX_BATCH = 256;
+
+    struct Entry {
+        std::chrono::nanoseconds timestamp;
+        ReceivedSegments received;
+    };
+
+    double speed_;
+    std::vector<Entry> entries_;
+    size_t next_ = 0;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<int64_t> handler_ns_;
+    uint64_t sent_datagrams_ = 0;
+    uint64_t sent_bytes_ = 0;
+};
+
+}  // namespace network
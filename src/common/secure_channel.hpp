@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "chacha20_poly1305.hpp"
+#include "logger.hpp"
+#include "protocol.hpp"
+#include "x25519.hpp"
+
+namespace network {
+
+// Anti-replay window over 64-bit packet counters (RFC 6479 layout): a ring of bitmap
+// words that slides forward with the highest counter seen. Counters more than
+// WINDOW_SIZE behind the highest one are rejected outright.
+class ReplayWindow {
+   public:
+    static constexpr size_t WORDS = 16;
+    static constexpr uint64_t WINDOW_SIZE = (WORDS - 1) * 64;
+
+    // Read-only check, so a forged packet cannot move the window before its tag is verified.
+    bool check(uint64_t counter) const {
+        if (!seen_any_) {
+            return true;
+        }
+        if (counter > highest_) {
+            return true;
+        }
+        if (highest_ - counter >= WINDOW_SIZE) {
+            return false;
+        }
+        return (bitmap_[(counter / 64) % WORDS] & (1ULL << (counter % 64))) == 0;
+    }
+
+    void update(uint64_t counter) {
+        if (!seen_any_) {
+            highest_ = counter;
+            seen_any_ = true;
+        } else if (counter > highest_) {
+            uint64_t current = highest_ / 64;
+            uint64_t target = counter / 64;
+            uint64_t steps = target - current;
+            if (steps > WORDS) {
+                steps = WORDS;
+            }
+            for (uint64_t i = 1; i <= steps; ++i) {
+                bitmap_[(current + i) % WORDS] = 0;
+            }
+            highest_ = counter;
+        }
+        bitmap_[(counter / 64) % WORDS] |= 1ULL << (counter % 64);
+    }
+
+   private:
+    uint64_t highest_ = 0;
+    bool seen_any_ = false;
+    std::array<uint64_t, WORDS> bitmap_{};
+};
+
+// Authenticated encryption for the peer channel. Each side generates an X25519 key pair
+// and advertises the public half in its HOLE_PUNCH capabilities ("key=<64 hex>"). Both
+// sides derive the same base key, HChaCha20(X25519 shared secret, 0), and from it one
+// ChaCha20-Poly1305 key per direction, assigned by comparing the public keys. Every
+// datagram is then sent as
+//     SEALED:<8-byte little-endian counter><ciphertext><16-byte tag>
+// with the counter doubling as the nonce, and checked against a replay window on receipt.
+// seal() may run on a sending thread while open() runs on the receiving thread; each
+// touches only its own direction's state once the session is established.
+class SecureChannel {
+   public:
+    static constexpr const char* PREFIX = "SEALED:";
+    static constexpr size_t PREFIX_SIZE = 7;
+    static constexpr size_t COUNTER_SIZE = 8;
+    static constexpr size_t OVERHEAD =
+        PREFIX_SIZE + COUNTER_SIZE + ChaCha20Poly1305::TAG_SIZE;
+
+    explicit SecureChannel(bool enabled = true)
+        : enabled_(enabled), established_(false), send_counter_(0) {
+        if (enabled_) {
+            private_key_ = X25519::generatePrivateKey();
+            public_key_ = X25519::publicKey(private_key_);
+        }
+    }
+
+    ~SecureChannel() {
+        ChaCha20Poly1305::secureZero(private_key_.data(), private_key_.size());
+    }
+
+    SecureChannel(const SecureChannel&) = delete;
+    SecureChannel& operator=(const SecureChannel&) = delete;
+
+    bool isEnabled() const { return enabled_; }
+    bool isEstablished() const { return established_; }
+
+    // Per-datagram bytes added by seal(); 0 when encryption is disabled.
+    size_t getOverhead() const { return enabled_ ? OVERHEAD : 0; }
+
+    std::string getCapabilities() const {
+        return enabled_ ? "key=" + toHex(public_key_.data(), public_key_.size()) : "";
+    }
+
+    // Derives the session keys from the peer's capabilities. Returns false if the peer
+    // offered no usable key. A session, once established, is never rekeyed to another key.
+    bool setPeerCapabilities(const std::string& capabilities) {
+        if (!enabled_) {
+            return false;
+        }
+
+        std::string key_hex;
+        std::stringstream ss(capabilities);
+        std::string token;
+        while (std::getline(ss, token, ';')) {
+            if (token.rfind("key=", 0) == 0) {
+                key_hex = token.substr(4);
+            }
+        }
+
+        X25519::Key peer_key;
+        if (!fromHex(key_hex, peer_key.data(), peer_key.size())) {
+            Logger::warning("Peer offered no valid encryption key");
+            return false;
+        }
+
+        if (established_) {
+            if (peer_key != peer_public_key_) {
+                Logger::warning("Ignoring key change from peer on established session");
+                return false;
+            }
+            return true;
+        }
+
+        X25519::Key shared;
+        if (!X25519::sharedSecret(private_key_, peer_key, shared)) {
+            Logger::warning("Peer offered a low-order encryption key");
+            return false;
+        }
+
+        static const uint8_t zero[16] = {};
+        ChaCha20Poly1305::Key base = ChaCha20Poly1305::hchacha20(shared.data(), zero);
+        ChaCha20Poly1305::secureZero(shared.data(), shared.size());
+
+        bool low = public_key_ < peer_key;
+        ChaCha20Poly1305::Key low_to_high = derive(base, "p2p low->high");
+        ChaCha20Poly1305::Key high_to_low = derive(base, "p2p high->low");
+        ChaCha20Poly1305::Key fingerprint = derive(base, "p2p fingerprint");
+        ChaCha20Poly1305::secureZero(base.data(), base.size());
+
+        sender_ = std::make_unique<ChaCha20Poly1305>(low ? low_to_high : high_to_low);
+        receiver_ = std::make_unique<ChaCha20Poly1305>(low ? high_to_low : low_to_high);
+        ChaCha20Poly1305::secureZero(low_to_high.data(), low_to_high.size());
+        ChaCha20Poly1305::secureZero(high_to_low.data(), high_to_low.size());
+
+        peer_public_key_ = peer_key;
+        fingerprint_ = toHex(fingerprint.data(), 8);
+        established_ = true;
+
+        Logger::info("Secure session established, fingerprint: " + fingerprint_);
+        return true;
+    }
+
+    // Short string both peers derive identically; comparing it out of band detects a
+    // man in the middle on the (unauthenticated) hole punch.
+    const std::string& getFingerprint() const { return fingerprint_; }
+
+    // Builds the sealed datagram: the plaintext is copied once behind the header and
+    // encrypted in place in the outgoing buffer.
+    std::string seal(const std::string& plaintext) { return seal({plaintext}); }
+
+    // Seals the concatenation of `parts`, gathered straight into the outgoing buffer.
+    std::string seal(std::initializer_list<std::string_view> parts) {
+        if (!established_) {
+            throw std::runtime_error("Secure session with peer not established");
+        }
+        if (send_counter_ == UINT64_MAX) {
+            throw std::runtime_error("Secure session counter exhausted");
+        }
+        uint64_t counter = send_counter_++;
+
+        size_t length = 0;
+        for (const auto& part : parts) {
+            length += part.size();
+        }
+
+        std::string packet(OVERHEAD + length, '\0');
+        auto* bytes = reinterpret_cast<uint8_t*>(&packet[0]);
+        std::memcpy(bytes, PREFIX, PREFIX_SIZE);
+        storeCounter(bytes + PREFIX_SIZE, counter);
+
+        uint8_t* payload = bytes + PREFIX_SIZE + COUNTER_SIZE;
+        size_t offset = 0;
+        for (const auto& part : parts) {
+            std::memcpy(payload + offset, part.data(), part.size());
+            offset += part.size();
+        }
+        auto tag = sender_->seal(makeNonce(counter), payload, length);
+        std::memcpy(payload + length, tag.data(), tag.size());
+        return packet;
+    }
+
+    // Takes the data part of a SEALED datagram, authenticates and decrypts it in place,
+    // leaving the plaintext in `data`. Returns false for forged, corrupt or replayed data.
+    bool open(std::string& data) {
+        constexpr size_t FRAMING = COUNTER_SIZE + ChaCha20Poly1305::TAG_SIZE;
+        if (!established_ || data.size() < FRAMING) {
+            return false;
+        }
+
+        auto* bytes = reinterpret_cast<uint8_t*>(&data[0]);
+        uint64_t counter = loadCounter(bytes);
+        if (!replay_window_.check(counter)) {
+            Logger::debug("Dropping replayed packet " + std::to_string(counter));
+            return false;
+        }
+
+        size_t length = data.size() - FRAMING;
+        uint8_t* payload = bytes + COUNTER_SIZE;
+        if (!receiver_->open(makeNonce(counter), payload, length, payload + length)) {
+            return false;
+        }
+        replay_window_.update(counter);
+
+        data.erase(0, COUNTER_SIZE);
+        data.resize(length);
+        return true;
+    }
+
+   private:
+    static ChaCha20Poly1305::Key derive(const ChaCha20Poly1305::Key& base, const char* label) {
+        uint8_t input[16] = {};
+        std::memcpy(input, label, std::min<size_t>(std::strlen(label), sizeof(input)));
+        return ChaCha20Poly1305::hchacha20(base.data(), input);
+    }
+
+    static ChaCha20Poly1305::Nonce makeNonce(uint64_t counter) {
+        ChaCha20Poly1305::Nonce nonce{};
+        storeCounter(nonce.data() + 4, counter);
+        return nonce;
+    }
+
+    static void storeCounter(uint8_t* p, uint64_t counter) {
+        for (size_t i = 0; i < COUNTER_SIZE; ++i) {
+            p[i] = static_cast<uint8_t>(counter >> (8 * i));
+        }
+    }
+
+    static uint64_t loadCounter(const uint8_t* p) {
+        uint64_t counter = 0;
+        for (size_t i = COUNTER_SIZE; i-- > 0;) {
+            counter = (counter << 8) | p[i];
+        }
+        return counter;
+    }
+
+    static std::string toHex(const uint8_t* data, size_t size) {
+        std::string hex;
+        hex.reserve(size * 2);
+        char byte[3];
+        for (size_t i = 0; i < size; ++i) {
+            std::snprintf(byte, sizeof(byte), "%02x", data[i]);
+            hex += byte;
+        }
+        return hex;
+    }
+
+    static bool fromHex(const std::string& hex, uint8_t* out, size_t size) {
+        if (hex.size() != size * 2) {
+            return false;
+        }
+        auto nibble = [](char c) -> int {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            return -1;
+        };
+        for (size_t i = 0; i < size; ++i) {
+            int high = nibble(hex[2 * i]);
+            int low = nibble(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            out[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        return true;
+    }
+
+    bool enabled_;
+    std::atomic<bool> established_;
+    X25519::Key private_key_{};
+    X25519::Key public_key_{};
+    X25519::Key peer_public_key_{};
+    std::string fingerprint_;
+    std::unique_ptr<ChaCha20Poly1305> sender_;
+    std::unique_ptr<ChaCha20Poly1305> receiver_;
+    uint64_t send_counter_;
+    ReplayWindow replay_window_;
+};
+
+}  // namespace network
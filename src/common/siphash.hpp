@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "random.hpp"
+
+namespace network {
+
+// SipHash-2-4: a fast keyed PRF for short inputs, used as a MAC for stateless cookies
+// and to hash attacker-chosen keys into tables without predictable collisions.
+class SipHash {
+   public:
+    using Key = std::array<uint8_t, 16>;
+
+    static Key randomKey() {
+        Key key;
+        fillRandom(key.data(), key.size());
+        return key;
+    }
+
+    static uint64_t hash(const Key& key, const void* data, size_t length) {
+        const auto* in = static_cast<const uint8_t*>(data);
+        uint64_t k0 = load64(key.data());
+        uint64_t k1 = load64(key.data() + 8);
+
+        uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+        uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+        uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+        uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+        size_t tail = length & 7;
+        const uint8_t* end = in + (length - tail);
+        for (; in != end; in += 8) {
+            uint64_t m = load64(in);
+            v3 ^= m;
+            round(v0, v1, v2, v3);
+            round(v0, v1, v2, v3);
+            v0 ^= m;
+        }
+
+        uint64_t b = static_cast<uint64_t>(length) << 56;
+        for (size_t i = 0; i < tail; ++i) {
+            b |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        v3 ^= b;
+        round(v0, v1, v2, v3);
+        round(v0, v1, v2, v3);
+        v0 ^= b;
+
+        v2 ^= 0xff;
+        for (int i = 0; i < 4; ++i) {
+            round(v0, v1, v2, v3);
+        }
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+   private:
+    static uint64_t load64(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;  // little-endian hosts only, like the rest of the wire code
+    }
+
+    static uint64_t rotl(uint64_t v, int n) { return (v << n) | (v >> (64 - n)); }
+
+    static void round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+        v0 += v1;
+        v1 = rotl(v1, 13);
+        v1 ^= v0;
+        v0 = rotl(v0, 32);
+        v2 += v3;
+        v3 = rotl(v3, 16);
+        v3 ^= v2;
+        v0 += v3;
+        v3 = rotl(v3, 21);
+        v3 ^= v0;
+        v2 += v1;
+        v1 = rotl(v1, 17);
+        v1 ^= v2;
+        v2 = rotl(v2, 32);
+    }
+};
+
+}  // namespace network
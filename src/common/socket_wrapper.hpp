@@ -3,33 +3,96 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <linux/net_tstamp.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "endpoint.hpp"
 #include "logger.hpp"
 
 namespace network {
 
+struct SocketOptions {
+    enum class PmtuDiscovery { DEFAULT, DO, DONT, WANT, PROBE };
+
+    int recv_buffer = 0;  // SO_RCVBUF in bytes, 0 keeps the kernel default
+    int send_buffer = 0;  // SO_SNDBUF in bytes, 0 keeps the kernel default
+    bool force_buffers = false;  // SO_*BUFFORCE, needs CAP_NET_ADMIN to exceed rmem_max/wmem_max
+    int busy_poll_us = 0;  // SO_BUSY_POLL, 0 disables
+    int tos = -1;  // IP_TOS byte (DSCP << 2 | ECN), -1 keeps the default
+    bool timestamping = false;  // SO_TIMESTAMPING software receive timestamps
+    PmtuDiscovery pmtu = PmtuDiscovery::DEFAULT;  // IP_MTU_DISCOVER
+    uint16_t gso_segment = 0;  // UDP_SEGMENT size for batched sends, 0 disables GSO
+    bool gro = false;  // UDP_GRO coalescing on receive
+};
+
+struct ReceivedSegments {
+    std::vector<std::string> segments;
+    Endpoint sender;
+    std::chrono::nanoseconds kernel_timestamp{0};  // zero unless timestamping is enabled
+};
+
 class SocketWrapper {
    public:
     enum class Type { TCP, UDP };
+    // DUAL_STACK sockets are AF_INET6 with IPV6_V6ONLY off and reach IPv4 endpoints
+    // through v4-mapped addresses; on a kernel without IPv6 they fall back to AF_INET.
+    enum class Family { IPV4, DUAL_STACK };
+
+    // The family for a socket bound to `local`. One bound to an IPv4 address, the wildcard
+    // included, only ever talks IPv4 and avoids the v4-mapped path, which costs a
+    // forwarding server about a third of its packet rate.
+    static Family familyFor(const Endpoint& local) {
+        return local.isIpv4() ? Family::IPV4 : Family::DUAL_STACK;
+    }
 
-    explicit SocketWrapper(Type type) : type_(type), fd_(-1) {
-        int domain = AF_INET;
+    // Largest UDP payload (and largest GRO train) a single receive can return.
+    static constexpr size_t MAX_DATAGRAM_SIZE = 65536;
+
+    explicit SocketWrapper(Type type, Family family = Family::DUAL_STACK) : type_(type), fd_(-1) {
         int socket_type = (type == Type::TCP) ? SOCK_STREAM : SOCK_DGRAM;
         int protocol = 0;
 
-        fd_ = socket(domain, socket_type, protocol);
+        if (family == Family::DUAL_STACK) {
+            fd_ = socket(AF_INET6, socket_type, protocol);
+            int v6_only = 0;
+            if (fd_ >= 0 && setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only)) < 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        if (fd_ < 0) {
+            family_ = AF_INET;
+            fd_ = socket(AF_INET, socket_type, protocol);
+        }
         if (fd_ < 0) {
             throw std::runtime_error("Failed to create socket");
         }
 
-        Logger::debug("Socket created with fd: " + std::to_string(fd_));
+        Logger::debug("Socket created with fd: " + std::to_string(fd_) +
+                      (family_ == AF_INET6 ? " (dual-stack)" : " (IPv4)"));
+    }
+
+    // Takes ownership of an open socket, e.g. one inherited from another process.
+    SocketWrapper(Type type, int fd) : type_(type), fd_(fd) {
+        struct sockaddr_storage local{};
+        socklen_t length = sizeof(local);
+        if (getsockname(fd_, reinterpret_cast<struct sockaddr*>(&local), &length) == 0) {
+            family_ = local.ss_family;
+        }
+        Logger::debug("Socket adopted with fd: " + std::to_string(fd_));
     }
 
     ~SocketWrapper() {
@@ -41,7 +104,15 @@ class SocketWrapper {
 
     SocketWrapper(const SocketWrapper&) = delete;
     SocketWrapper& operator=(const SocketWrapper&) = delete;
-    SocketWrapper(SocketWrapper&& other) noexcept : type_(other.type_), fd_(other.fd_) {
+    SocketWrapper(SocketWrapper&& other) noexcept
+        : type_(other.type_),
+          fd_(other.fd_),
+          family_(other.family_),
+          peer_(other.peer_),
+          gso_segment_(other.gso_segment_),
+          gro_(other.gro_),
+          timestamping_(other.timestamping_),
+          recv_buffer_(std::move(other.recv_buffer_)) {
         other.fd_ = -1;
     }
 
@@ -52,6 +123,12 @@ class SocketWrapper {
             }
             type_ = other.type_;
             fd_ = other.fd_;
+            family_ = other.family_;
+            peer_ = other.peer_;
+            gso_segment_ = other.gso_segment_;
+            gro_ = other.gro_;
+            timestamping_ = other.timestamping_;
+            recv_buffer_ = std::move(other.recv_buffer_);
             other.fd_ = -1;
         }
         return *this;
@@ -59,31 +136,24 @@ class SocketWrapper {
 
     int getFd() const { return fd_; }
     Type getType() const { return type_; }
+    // AF_INET6 for a dual-stack socket, AF_INET otherwise.
+    int getFamily() const { return family_; }
 
-    void bind(const std::string& address, uint16_t port) {
-        struct sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(port);
+    void bind(const std::string& address, uint16_t port) { bind(Endpoint(address, port)); }
 
-        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) <= 0) {
-            throw std::runtime_error("Invalid address: " + address);
+    void bind(const Endpoint& local) {
+        Endpoint address = toNative(local);
+        if (::bind(fd_, address.data(), address.length()) < 0) {
+            throw std::runtime_error("Failed to bind socket to " + local.toString());
         }
 
-        if (::bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
-            throw std::runtime_error("Failed to bind socket to " + address + ":" +
-                                     std::to_string(port));
-        }
-
-        Logger::info("Socket bound to " + address + ":" + std::to_string(port));
+        Logger::info("Socket bound to " + local.toString());
     }
 
+    // Binds the wildcard address: every interface, both families on a dual-stack socket.
     void bind(uint16_t port) {
-        struct sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port = htons(port);
-
-        if (::bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        Endpoint any(family_ == AF_INET6 ? "::" : "0.0.0.0", port);
+        if (::bind(fd_, any.data(), any.length()) < 0) {
             throw std::runtime_error("Failed to bind socket to port " + std::to_string(port));
         }
 
@@ -107,45 +177,36 @@ class SocketWrapper {
             throw std::runtime_error("Accept is only available for TCP sockets");
         }
 
-        struct sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
+        Endpoint client_addr;
+        socklen_t client_len = Endpoint::CAPACITY;
 
-        int client_fd =
-            ::accept(fd_, reinterpret_cast<struct sockaddr*>(&client_addr), &client_len);
+        int client_fd = ::accept(fd_, client_addr.data(), &client_len);
         if (client_fd < 0) {
             throw std::runtime_error("Failed to accept connection");
         }
 
-        auto client_socket = std::make_unique<SocketWrapper>(Type::TCP);
-        client_socket->fd_ = client_fd;
-
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        uint16_t client_port = ntohs(client_addr.sin_port);
-
-        Logger::info("Accepted connection from " + std::string(client_ip) + ":" +
-                     std::to_string(client_port));
+        auto client_socket = std::make_unique<SocketWrapper>(Type::TCP, client_fd);
+        Logger::info("Accepted connection from " + client_addr.unmapped().toString());
 
         return client_socket;
     }
 
-    void connect(const std::string& address, uint16_t port) {
-        struct sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(port);
+    void connect(const std::string& address, uint16_t port) { connect(Endpoint(address, port)); }
 
-        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) <= 0) {
-            throw std::runtime_error("Invalid address: " + address);
+    // For UDP, fixes the destination: the kernel resolves the route once and delivers only
+    // datagrams from `remote`. Sends to `remote` then go out without an address.
+    void connect(const Endpoint& remote) {
+        Endpoint address = toNative(remote);
+        if (::connect(fd_, address.data(), address.length()) < 0) {
+            throw std::runtime_error("Failed to connect to " + remote.toString());
         }
+        peer_ = remote;
 
-        if (::connect(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
-            throw std::runtime_error("Failed to connect to " + address + ":" +
-                                     std::to_string(port));
-        }
-
-        Logger::info("Connected to " + address + ":" + std::to_string(port));
+        Logger::info("Connected to " + remote.toString());
     }
 
+    bool isConnectedTo(const Endpoint& to) const { return !peer_.empty() && peer_ == to; }
+
     ssize_t send(const std::string& data) {
         ssize_t bytes_sent = ::send(fd_, data.c_str(), data.length(), 0);
         if (bytes_sent < 0) {
@@ -156,33 +217,73 @@ class SocketWrapper {
         return bytes_sent;
     }
 
-    ssize_t sendto(const std::string& data, const std::string& address, uint16_t port) {
+    ssize_t sendto(const std::string& data, const Endpoint& to) {
         if (type_ != Type::UDP) {
             throw std::runtime_error("Sendto is only available for UDP sockets");
         }
 
-        struct sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(port);
+        ssize_t bytes_sent;
+        if (isConnectedTo(to)) {
+            bytes_sent = ::send(fd_, data.c_str(), data.length(), 0);
+        } else {
+            Endpoint address = toNative(to);
+            bytes_sent = ::sendto(fd_, data.c_str(), data.length(), 0, address.data(), address.length());
+        }
+        if (bytes_sent < 0) {
+            throw std::runtime_error("Failed to send data via UDP");
+        }
+
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Sent " + std::to_string(bytes_sent) + " bytes via UDP to " + to.toString());
+        }
+        return bytes_sent;
+    }
+
+    // Sends one datagram gathered from `parts`, so a header and a payload go out without
+    // being copied into one buffer first. To the connected peer this is a writev().
+    ssize_t sendv(std::initializer_list<std::string_view> parts, const Endpoint& to) {
+        if (type_ != Type::UDP) {
+            throw std::runtime_error("Sendto is only available for UDP sockets");
+        }
+        if (parts.size() > MAX_PARTS) {
+            throw std::runtime_error("Too many parts for one datagram: " + std::to_string(parts.size()));
+        }
+
+        struct iovec iovs[MAX_PARTS];
+        size_t count = 0;
+        for (const auto& part : parts) {
+            iovs[count].iov_base = const_cast<char*>(part.data());
+            iovs[count].iov_len = part.size();
+            ++count;
+        }
 
-        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) <= 0) {
-            throw std::runtime_error("Invalid address: " + address);
+        Endpoint address;
+        struct msghdr msg{};
+        if (!isConnectedTo(to)) {
+            address = toNative(to);
+            msg.msg_name = address.data();
+            msg.msg_namelen = address.length();
         }
+        msg.msg_iov = iovs;
+        msg.msg_iovlen = count;
 
-        ssize_t bytes_sent = ::sendto(fd_, data.c_str(), data.length(), 0,
-                                      reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        ssize_t bytes_sent = ::sendmsg(fd_, &msg, 0);
         if (bytes_sent < 0) {
             throw std::runtime_error("Failed to send data via UDP");
         }
 
-        Logger::debug("Sent " + std::to_string(bytes_sent) + " bytes via UDP to " + address + ":" +
-                      std::to_string(port));
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Sent " + std::to_string(bytes_sent) + " bytes in " + std::to_string(count) +
+                          " parts via UDP to " + to.toString());
+        }
         return bytes_sent;
     }
 
-    std::string receive(size_t max_size = 4096) {
-        std::vector<char> buffer(max_size);
-        ssize_t bytes_received = ::recv(fd_, buffer.data(), max_size - 1, 0);
+    std::string receive(size_t max_size = MAX_DATAGRAM_SIZE) {
+        if (recv_buffer_.size() < max_size) {
+            recv_buffer_.resize(max_size);
+        }
+        ssize_t bytes_received = ::recv(fd_, recv_buffer_.data(), max_size, 0);
 
         if (bytes_received < 0) {
             throw std::runtime_error("Failed to receive data");
@@ -193,41 +294,39 @@ class SocketWrapper {
             return "";
         }
 
-        buffer[bytes_received] = '\0';
-        std::string result(buffer.data());
+        std::string result(recv_buffer_.data(), static_cast<size_t>(bytes_received));
 
         Logger::debug("Received " + std::to_string(bytes_received) + " bytes");
         return result;
     }
 
-    std::pair<std::string, std::pair<std::string, uint16_t>> receivefrom(size_t max_size = 4096) {
+    std::pair<std::string, Endpoint> receivefrom(size_t max_size = MAX_DATAGRAM_SIZE) {
         if (type_ != Type::UDP) {
             throw std::runtime_error("Receivefrom is only available for UDP sockets");
         }
 
-        std::vector<char> buffer(max_size);
-        struct sockaddr_in sender_addr{};
-        socklen_t sender_len = sizeof(sender_addr);
+        if (recv_buffer_.size() < max_size) {
+            recv_buffer_.resize(max_size);
+        }
+        Endpoint sender;
+        socklen_t sender_len = Endpoint::CAPACITY;
 
         ssize_t bytes_received =
-            ::recvfrom(fd_, buffer.data(), max_size - 1, 0,
-                       reinterpret_cast<struct sockaddr*>(&sender_addr), &sender_len);
+            ::recvfrom(fd_, recv_buffer_.data(), max_size, 0, sender.data(), &sender_len);
 
         if (bytes_received < 0) {
             throw std::runtime_error("Failed to receive data via UDP");
         }
 
-        buffer[bytes_received] = '\0';
-        std::string data(buffer.data());
+        std::string data(recv_buffer_.data(), static_cast<size_t>(bytes_received));
+        sender = sender.unmapped();
 
-        char sender_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &sender_addr.sin_addr, sender_ip, INET_ADDRSTRLEN);
-        uint16_t sender_port = ntohs(sender_addr.sin_port);
-
-        Logger::debug("Received " + std::to_string(bytes_received) + " bytes via UDP from " +
-                      std::string(sender_ip) + ":" + std::to_string(sender_port));
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Received " + std::to_string(bytes_received) + " bytes via UDP from " +
+                          sender.toString());
+        }
 
-        return {data, {std::string(sender_ip), sender_port}};
+        return {data, sender};
     }
 
     void setNonBlocking(bool non_blocking = true) {
@@ -250,23 +349,393 @@ class SocketWrapper {
                       " mode");
     }
 
-    std::pair<std::string, uint16_t> getLocalAddress() const {
-        struct sockaddr_in addr{};
-        socklen_t len = sizeof(addr);
-        if (getsockname(fd_, reinterpret_cast<struct sockaddr*>(&addr), &len) < 0) {
+    Endpoint getLocalAddress() const {
+        Endpoint local;
+        socklen_t len = Endpoint::CAPACITY;
+        if (getsockname(fd_, local.data(), &len) < 0) {
             throw std::runtime_error("Failed to get local address");
         }
+        return local.unmapped();
+    }
+
+    void applyOptions(const SocketOptions& options) {
+        if (options.recv_buffer > 0) {
+            setReceiveBufferSize(options.recv_buffer, options.force_buffers);
+        }
+        if (options.send_buffer > 0) {
+            setSendBufferSize(options.send_buffer, options.force_buffers);
+        }
+        if (options.busy_poll_us > 0) {
+            setBusyPoll(options.busy_poll_us);
+        }
+        if (options.tos >= 0) {
+            setTos(options.tos);
+        }
+        if (options.timestamping) {
+            setTimestamping(true);
+        }
+        if (options.pmtu != SocketOptions::PmtuDiscovery::DEFAULT) {
+            setMtuDiscover(options.pmtu);
+        }
+        if (options.gso_segment > 0) {
+            setGsoSegment(options.gso_segment);
+        }
+        if (options.gro) {
+            setGro(true);
+        }
+    }
+
+    void setReceiveBufferSize(int bytes, bool force = false) {
+        if (force && trySetOption(SOL_SOCKET, SO_RCVBUFFORCE, bytes)) {
+            Logger::debug("Receive buffer forced to " + std::to_string(bytes) + " bytes");
+            return;
+        }
+        if (force) {
+            Logger::warning("SO_RCVBUFFORCE not permitted, falling back to SO_RCVBUF");
+        }
+        setOption(SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+        Logger::debug("Receive buffer set to " + std::to_string(bytes) + " bytes");
+    }
+
+    void setSendBufferSize(int bytes, bool force = false) {
+        if (force && trySetOption(SOL_SOCKET, SO_SNDBUFFORCE, bytes)) {
+            Logger::debug("Send buffer forced to " + std::to_string(bytes) + " bytes");
+            return;
+        }
+        if (force) {
+            Logger::warning("SO_SNDBUFFORCE not permitted, falling back to SO_SNDBUF");
+        }
+        setOption(SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+        Logger::debug("Send buffer set to " + std::to_string(bytes) + " bytes");
+    }
 
-        char ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &addr.sin_addr, ip, INET_ADDRSTRLEN);
-        uint16_t port = ntohs(addr.sin_port);
+    void setBusyPoll(int usec) {
+        setOption(SOL_SOCKET, SO_BUSY_POLL, usec, "SO_BUSY_POLL");
+        Logger::debug("Busy poll set to " + std::to_string(usec) + " us");
+    }
 
-        return {std::string(ip), port};
+    void setTos(int tos) {
+        setOption(IPPROTO_IP, IP_TOS, tos, "IP_TOS");
+        if (family_ == AF_INET6) {
+            setOption(IPPROTO_IPV6, IPV6_TCLASS, tos, "IPV6_TCLASS");
+        }
+        Logger::debug("IP_TOS set to " + std::to_string(tos));
+    }
+
+    void setTimestamping(bool enable) {
+        int flags = enable ? (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE) : 0;
+        setOption(SOL_SOCKET, SO_TIMESTAMPING, flags, "SO_TIMESTAMPING");
+        timestamping_ = enable;
+        Logger::debug("Receive timestamping " + std::string(enable ? "enabled" : "disabled"));
+    }
+
+    void setMtuDiscover(SocketOptions::PmtuDiscovery mode) {
+        int value = IP_PMTUDISC_DO;
+        switch (mode) {
+            case SocketOptions::PmtuDiscovery::DO:
+                value = IP_PMTUDISC_DO;
+                break;
+            case SocketOptions::PmtuDiscovery::DONT:
+                value = IP_PMTUDISC_DONT;
+                break;
+            case SocketOptions::PmtuDiscovery::WANT:
+                value = IP_PMTUDISC_WANT;
+                break;
+            case SocketOptions::PmtuDiscovery::PROBE:
+                value = IP_PMTUDISC_PROBE;
+                break;
+            default:
+                return;
+        }
+        setOption(IPPROTO_IP, IP_MTU_DISCOVER, value, "IP_MTU_DISCOVER");
+        if (family_ == AF_INET6) {
+            // The IPV6_PMTUDISC_* values equal their IPv4 counterparts.
+            setOption(IPPROTO_IPV6, IPV6_MTU_DISCOVER, value, "IPV6_MTU_DISCOVER");
+        }
+        Logger::debug("IP_MTU_DISCOVER set to " + std::to_string(value));
+    }
+
+    void setGsoSegment(uint16_t segment_size) {
+        if (type_ != Type::UDP) {
+            throw std::runtime_error("GSO is only available for UDP sockets");
+        }
+        // UDP_SEGMENT is passed per call as a control message so that each batch can
+        // pick its own segment size. Setting the socket option would segment every send,
+        // so it is only set and cleared again to probe kernel support.
+        if (segment_size > 0) {
+            if (!trySetOption(IPPROTO_UDP, UDP_SEGMENT, segment_size)) {
+                Logger::warning("UDP GSO not supported by kernel, batched sends will use sendmmsg");
+                gso_segment_ = 0;
+                return;
+            }
+            trySetOption(IPPROTO_UDP, UDP_SEGMENT, 0);
+        }
+        gso_segment_ = segment_size;
+        Logger::debug("UDP GSO segment size set to " + std::to_string(segment_size));
+    }
+
+    void setGro(bool enable) {
+        if (type_ != Type::UDP) {
+            throw std::runtime_error("GRO is only available for UDP sockets");
+        }
+        if (!trySetOption(IPPROTO_UDP, UDP_GRO, enable ? 1 : 0)) {
+            Logger::warning("UDP GRO not supported by kernel");
+            gro_ = false;
+            return;
+        }
+        gro_ = enable;
+        Logger::debug("UDP GRO " + std::string(enable ? "enabled" : "disabled"));
+    }
+
+    // The address as this socket's family takes it: v4-mapped on a dual-stack socket.
+    // Backends that build their own msghdr (io_uring) convert through this too.
+    Endpoint toNative(const Endpoint& endpoint) const {
+        if (family_ == AF_INET6) {
+            return endpoint.mapped();
+        }
+        if (endpoint.isIpv6()) {
+            // An IPv4 fallback socket can still bind the IPv6 wildcard as its own.
+            if (IN6_IS_ADDR_UNSPECIFIED(reinterpret_cast<const struct in6_addr*>(endpoint.addressBytes()))) {
+                return Endpoint("0.0.0.0", endpoint.port());
+            }
+            throw std::runtime_error("IPv6 is not available for " + endpoint.toString());
+        }
+        return endpoint;
+    }
+
+    uint16_t getGsoSegment() const { return gso_segment_; }
+    bool isGroEnabled() const { return gro_; }
+    bool isTimestampingEnabled() const { return timestamping_; }
+
+    // Sends every datagram to the same destination with as few syscalls as possible.
+    // Runs of equally sized datagrams (the last one may be shorter) are coalesced into a
+    // single UDP_SEGMENT super-packet when GSO is enabled; everything else goes through
+    // one sendmmsg call.
+    size_t sendtoBatch(const std::vector<std::string>& datagrams, const Endpoint& to) {
+        if (type_ != Type::UDP) {
+            throw std::runtime_error("Sendto is only available for UDP sockets");
+        }
+        if (datagrams.empty()) {
+            return 0;
+        }
+
+        // The connected peer takes no address, see connect().
+        Endpoint native = toNative(to);
+        Endpoint* addr = isConnectedTo(to) ? nullptr : &native;
+        size_t sent = (gso_segment_ > 0) ? sendSegmented(datagrams, addr)
+                                         : sendMultiple(datagrams, addr);
+
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Sent batch of " + std::to_string(sent) + " datagrams via UDP to " +
+                          to.toString());
+        }
+        return sent;
+    }
+
+    // Receives one datagram, or one GRO-coalesced train of datagrams from a single sender,
+    // and splits it back into the original segments.
+    ReceivedSegments receiveSegmentsFrom(size_t max_size = MAX_DATAGRAM_SIZE) {
+        ReceivedSegments result;
+        if (!tryReceiveSegmentsFrom(result, max_size)) {
+            throw std::runtime_error("Failed to receive data via UDP");
+        }
+        return result;
+    }
+
+    // Non-throwing variant for event loops draining a non-blocking socket: returns false
+    // once the socket would block. The segments vector of `result` is reused.
+    bool tryReceiveSegmentsFrom(ReceivedSegments& result, size_t max_size = MAX_DATAGRAM_SIZE) {
+        if (type_ != Type::UDP) {
+            throw std::runtime_error("Receivefrom is only available for UDP sockets");
+        }
+
+        if (recv_buffer_.size() < max_size) {
+            recv_buffer_.resize(max_size);
+        }
+
+        struct iovec iov{recv_buffer_.data(), max_size};
+        alignas(struct cmsghdr) char control[RECEIVE_CONTROL_SIZE];
+
+        struct msghdr msg{};
+        msg.msg_name = result.sender.data();
+        msg.msg_namelen = Endpoint::CAPACITY;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t bytes_received = ::recvmsg(fd_, &msg, 0);
+        if (bytes_received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return false;
+            }
+            if (errno == ECONNREFUSED) {
+                // A connected socket reports an ICMP port unreachable from its peer here.
+                Logger::debug("Connected peer is unreachable");
+                return false;
+            }
+            throw std::runtime_error("Failed to receive data via UDP: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        size_t segment_size = static_cast<size_t>(bytes_received);
+        result.kernel_timestamp = std::chrono::nanoseconds(0);
+        parseControlMessages(msg, segment_size, result.kernel_timestamp);
+        splitSegments(recv_buffer_.data(), static_cast<size_t>(bytes_received), segment_size,
+                      result.segments);
+
+        result.sender = result.sender.unmapped();
+
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Received " + std::to_string(bytes_received) + " bytes in " +
+                          std::to_string(result.segments.size()) + " segment(s) via UDP from " +
+                          result.sender.toString());
+        }
+
+        return true;
+    }
+
+    // Control buffer large enough for a UDP_GRO segment size and an SCM_TIMESTAMPING triple.
+    static constexpr size_t RECEIVE_CONTROL_SIZE =
+        CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec) * 3);
+
+    static void parseControlMessages(struct msghdr& msg, size_t& segment_size,
+                                     std::chrono::nanoseconds& kernel_timestamp) {
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int gso_size = 0;
+                std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                if (gso_size > 0) {
+                    segment_size = static_cast<size_t>(gso_size);
+                }
+            } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                struct timespec ts[3];
+                std::memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+                kernel_timestamp = std::chrono::seconds(ts[0].tv_sec) +
+                                   std::chrono::nanoseconds(ts[0].tv_nsec);
+            }
+        }
+    }
+
+    static void splitSegments(const char* data, size_t length, size_t segment_size,
+                              std::vector<std::string>& segments) {
+        segments.clear();
+        if (length == 0 || segment_size == 0) {
+            segments.emplace_back();
+            return;
+        }
+        for (size_t offset = 0; offset < length; offset += segment_size) {
+            segments.emplace_back(data + offset, std::min(segment_size, length - offset));
+        }
     }
 
    private:
+    static constexpr size_t MAX_PARTS = 8;
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;
+    static constexpr size_t MAX_GSO_BYTES = 65507;
+
+    void setOption(int level, int name, int value, const char* option_name) {
+        if (setsockopt(fd_, level, name, &value, sizeof(value)) < 0) {
+            throw std::runtime_error(std::string("Failed to set ") + option_name + ": " +
+                                     std::strerror(errno));
+        }
+    }
+
+    bool trySetOption(int level, int name, int value) {
+        return setsockopt(fd_, level, name, &value, sizeof(value)) == 0;
+    }
+
+    size_t sendSegmented(const std::vector<std::string>& datagrams, Endpoint* addr) {
+        size_t sent = 0;
+        size_t i = 0;
+        std::string super_packet;
+
+        while (i < datagrams.size()) {
+            size_t segment_size = datagrams[i].size();
+            if (segment_size == 0 || segment_size > gso_segment_) {
+                sendMultiple({datagrams[i]}, addr);
+                ++sent;
+                ++i;
+                continue;
+            }
+
+            super_packet.clear();
+            size_t count = 0;
+            while (i < datagrams.size() && count < MAX_GSO_SEGMENTS &&
+                   super_packet.size() + datagrams[i].size() <= MAX_GSO_BYTES &&
+                   datagrams[i].size() <= segment_size && datagrams[i].size() > 0) {
+                super_packet += datagrams[i];
+                ++count;
+                // A shorter datagram can only terminate a GSO train.
+                if (datagrams[i++].size() < segment_size) {
+                    break;
+                }
+            }
+
+            struct iovec iov{super_packet.data(), super_packet.size()};
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))]{};
+
+            struct msghdr msg{};
+            msg.msg_name = addr ? addr->data() : nullptr;
+            msg.msg_namelen = addr ? addr->length() : 0;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            if (count > 1) {
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = static_cast<uint16_t>(segment_size);
+                std::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+
+            if (::sendmsg(fd_, &msg, 0) < 0) {
+                throw std::runtime_error("Failed to send data via UDP");
+            }
+            sent += count;
+        }
+
+        return sent;
+    }
+
+    size_t sendMultiple(const std::vector<std::string>& datagrams, Endpoint* addr) {
+        std::vector<struct iovec> iovs(datagrams.size());
+        std::vector<struct mmsghdr> msgs(datagrams.size());
+
+        for (size_t i = 0; i < datagrams.size(); ++i) {
+            iovs[i].iov_base = const_cast<char*>(datagrams[i].data());
+            iovs[i].iov_len = datagrams[i].size();
+            msgs[i].msg_hdr.msg_name = addr ? addr->data() : nullptr;
+            msgs[i].msg_hdr.msg_namelen = addr ? addr->length() : 0;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t sent = 0;
+        while (sent < msgs.size()) {
+            int result = ::sendmmsg(fd_, msgs.data() + sent,
+                                    static_cast<unsigned int>(msgs.size() - sent), 0);
+            if (result < 0) {
+                throw std::runtime_error("Failed to send data via UDP");
+            }
+            sent += static_cast<size_t>(result);
+        }
+
+        return sent;
+    }
+
     Type type_;
     int fd_;
+    int family_ = AF_INET6;
+    Endpoint peer_;  // set by connect()
+    uint16_t gso_segment_ = 0;
+    bool gro_ = false;
+    bool timestamping_ = false;
+    std::vector<char> recv_buffer_;
 };
 
 }  // namespace network
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "logger.hpp"
+
+namespace network {
+
+// Spans of work with monotonic nanosecond timestamps, kept in a ring buffer per thread and
+// written out as Chrome trace-event JSON, for chrome://tracing or ui.perfetto.dev. Answers
+// where the time of one connection went, which interleaved log lines cannot. Off unless
+// enable() was called; a span on a disabled tracer costs a relaxed load and a branch.
+class Tracer {
+   public:
+    static constexpr size_t DEFAULT_CAPACITY = 16384;  // spans kept per thread
+    static constexpr std::chrono::seconds FLUSH_INTERVAL{5};
+
+    struct Event {
+        const char* name;      // string literals only, never copied
+        const char* category;
+        int64_t start_ns;
+        int64_t duration_ns;
+        char id[48];  // session or client the span belongs to, empty if none
+    };
+
+    // Starts recording; flush() writes the spans to `path`. Call once, before the
+    // threads being traced start.
+    static void enable(const std::string& path, size_t capacity = DEFAULT_CAPACITY) {
+        path_ = path;
+        capacity_ = std::max<size_t>(capacity, 1);
+        next_flush_ns_ = now() + std::chrono::nanoseconds(FLUSH_INTERVAL).count();
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    // Stops recording; spans already recorded are still written by flush().
+    static void disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Names the calling thread in the trace.
+    static void nameThread(const std::string& name) {
+        if (enabled()) {
+            ThreadBuffer& buffer = threadBuffer();
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            buffer.name = name;
+        }
+    }
+
+    // Tags the calling thread's later spans that carry no id of their own, e.g. with the
+    // session id once the rendezvous has paired the client.
+    static void setSession(const std::string& id) {
+        if (enabled()) {
+            threadSession() = id;
+        }
+    }
+
+    static void record(const char* name, const char* category, int64_t start_ns, int64_t end_ns,
+                       const std::string& id = "") {
+        const std::string& tag = id.empty() ? threadSession() : id;
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        Event& event = buffer.events[buffer.recorded % buffer.events.size()];
+        event.name = name;
+        event.category = category;
+        event.start_ns = start_ns;
+        event.duration_ns = end_ns - start_ns;
+        size_t length = std::min(tag.size(), sizeof(event.id) - 1);
+        std::memcpy(event.id, tag.data(), length);
+        event.id[length] = '\0';
+        ++buffer.recorded;
+    }
+
+    // Writes the spans every thread still holds, oldest first, replacing the file.
+    // Failures are logged: a trace is never worth stopping the traced process for.
+    static void flush() {
+        if (path_.empty()) {
+            return;
+        }
+        std::string json = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+        size_t spans = 0;
+        {
+            std::lock_guard<std::mutex> registry_lock(registry_mutex_);
+            long pid = ::getpid();
+            for (const auto& buffer : registry_) {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                if (!buffer->name.empty()) {
+                    appendThreadName(json, pid, *buffer);
+                }
+                size_t size = buffer->events.size();
+                uint64_t first = buffer->recorded > size ? buffer->recorded - size : 0;
+                for (uint64_t i = first; i < buffer->recorded; ++i) {
+                    appendSpan(json, pid, buffer->tid, buffer->events[i % size]);
+                    ++spans;
+                }
+            }
+        }
+        if (json.back() == ',') {
+            json.pop_back();
+        }
+        json += "\n]}\n";
+
+        // Replaced in one rename, so a reader never sees half a file.
+        std::string temporary = path_ + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "w");
+        bool written = file != nullptr && std::fwrite(json.data(), 1, json.size(), file) == json.size();
+        if (file != nullptr) {
+            written = std::fclose(file) == 0 && written;
+        }
+        if (!written || std::rename(temporary.c_str(), path_.c_str()) != 0) {
+            Logger::warning("Failed to write trace to " + path_ + ": " + std::strerror(errno));
+            return;
+        }
+        if (Logger::enabled(Logger::Level::DEBUG)) {
+            Logger::debug("Wrote " + std::to_string(spans) + " spans to " + path_);
+        }
+    }
+
+    // flush() at most once every FLUSH_INTERVAL, for processes that run until killed.
+    static void flushIfDue() {
+        if (!enabled()) {
+            return;
+        }
+        int64_t current = now();
+        if (current >= next_flush_ns_) {
+            next_flush_ns_ = current + std::chrono::nanoseconds(FLUSH_INTERVAL).count();
+            flush();
+        }
+    }
+
+   private:
+    struct ThreadBuffer {
+        explicit ThreadBuffer(size_t capacity) : events(capacity), tid(::syscall(SYS_gettid)) {}
+
+        std::mutex mutex;  // taken by the owner per span, contended only by flush()
+        std::vector<Event> events;
+        uint64_t recorded = 0;
+        long tid;
+        std::string name;
+    };
+
+    // Allocated on the thread's first span and kept past its exit, so that the spans of
+    // finished threads are still written.
+    static ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            registry_.push_back(std::make_unique<ThreadBuffer>(capacity_));
+            buffer = registry_.back().get();
+        }
+        return *buffer;
+    }
+
+    static std::string& threadSession() {
+        thread_local std::string session;
+        return session;
+    }
+
+    static void appendEscaped(std::string& json, const char* text) {
+        for (; *text != '\0'; ++text) {
+            char c = *text;
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                json += escape;
+            } else {
+                json += c;
+            }
+        }
+    }
+
+    static void appendThreadName(std::string& json, long pid, const ThreadBuffer& buffer) {
+        json += "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " + std::to_string(pid) +
+                ", \"tid\": " + std::to_string(buffer.tid) + ", \"args\": {\"name\": \"";
+        appendEscaped(json, buffer.name.c_str());
+        json += "\"}},";
+    }
+
+    // A complete ("X") event; the format counts in microseconds, kept to the nanosecond.
+    static void appendSpan(std::string& json, long pid, long tid, const Event& event) {
+        char times[96];
+        std::snprintf(times, sizeof(times), "\"ts\": %lld.%03lld, \"dur\": %lld.%03lld",
+                      static_cast<long long>(event.start_ns / 1000),
+                      static_cast<long long>(event.start_ns % 1000),
+                      static_cast<long long>(event.duration_ns / 1000),
+                      static_cast<long long>(event.duration_ns % 1000));
+        json += "\n{\"name\": \"";
+        appendEscaped(json, event.name);
+        json += "\", \"cat\": \"";
+        appendEscaped(json, event.category);
+        json += "\", \"ph\": \"X\", \"pid\": " + std::to_string(pid) + ", \"tid\": " +
+                std::to_string(tid) + ", " + times;
+        if (event.id[0] != '\0') {
+            json += ", \"args\": {\"id\": \"";
+            appendEscaped(json, event.id);
+            json += "\"}";
+        }
+        json += "},";
+    }
+
+    inline static std::atomic<bool> enabled_{false};
+    inline static std::string path_;
+    inline static size_t capacity_ = DEFAULT_CAPACITY;
+    inline static int64_t next_flush_ns_ = 0;
+    inline static std::mutex registry_mutex_;
+    inline static std::vector<std::unique_ptr<ThreadBuffer>> registry_;
+};
+
+// Records the time from construction to end() or destruction as one span, if the tracer
+// was enabled when it started. `name` and `category` must be string literals.
+class TraceSpan {
+   public:
+    TraceSpan(const char* name, const char* category)
+        : name_(name), category_(category), start_ns_(Tracer::enabled() ? Tracer::now() : -1) {}
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // False on a disabled tracer; guards building an id that would be dropped.
+    bool active() const { return start_ns_ >= 0; }
+
+    // Attributes the span to a session or client instead of the thread's session.
+    void setId(const std::string& id) {
+        if (active()) {
+            id_ = id;
+        }
+    }
+
+    void end() {
+        if (active()) {
+            Tracer::record(name_, category_, start_ns_, Tracer::now(), id_);
+            start_ns_ = -1;
+        }
+    }
+
+   private:
+    const char* name_;
+    const char* category_;
+    int64_t start_ns_;
+    std::string id_;
+};
+
+}  // namespace network
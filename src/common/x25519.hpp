@@ -0,0 +1,262 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "random.hpp"
+
+namespace network {
+
+// X25519 Diffie-Hellman (RFC 7748) over 5x51-bit limbs with 128-bit products, in the
+// style of curve25519-donna-c64. The Montgomery ladder runs in constant time with
+// masked conditional swaps.
+class X25519 {
+   public:
+    static constexpr size_t KEY_SIZE = 32;
+    using Key = std::array<uint8_t, KEY_SIZE>;
+
+    static Key generatePrivateKey() {
+        Key key;
+        fillRandom(key.data(), key.size());
+        return key;
+    }
+
+    static Key publicKey(const Key& private_key) {
+        Key base{};
+        base[0] = 9;
+        return scalarMult(private_key, base);
+    }
+
+    // Returns false for low-order peer keys, which yield an all-zero shared secret.
+    static bool sharedSecret(const Key& private_key, const Key& peer_public, Key& out) {
+        out = scalarMult(private_key, peer_public);
+        uint8_t acc = 0;
+        for (uint8_t byte : out) {
+            acc |= byte;
+        }
+        return acc != 0;
+    }
+
+    static Key scalarMult(const Key& scalar, const Key& point) {
+        uint8_t k[KEY_SIZE];
+        std::memcpy(k, scalar.data(), KEY_SIZE);
+        k[0] &= 248;
+        k[31] &= 127;
+        k[31] |= 64;
+
+        Fe x1, x2, z2, x3, z3;
+        fromBytes(x1, point.data());
+        x2 = Fe{1, 0, 0, 0, 0};
+        z2 = Fe{0, 0, 0, 0, 0};
+        x3 = x1;
+        z3 = Fe{1, 0, 0, 0, 0};
+
+        uint64_t swap = 0;
+        for (int t = 254; t >= 0; --t) {
+            uint64_t bit = (k[t >> 3] >> (t & 7)) & 1;
+            swap ^= bit;
+            conditionalSwap(x2, x3, swap);
+            conditionalSwap(z2, z3, swap);
+            swap = bit;
+
+            Fe a, aa, b, bb, e, c, d, da, cb;
+            add(a, x2, z2);
+            square(aa, a);
+            sub(b, x2, z2);
+            square(bb, b);
+            sub(e, aa, bb);
+            add(c, x3, z3);
+            sub(d, x3, z3);
+            mul(da, d, a);
+            mul(cb, c, b);
+
+            Fe sum, diff;
+            add(sum, da, cb);
+            square(x3, sum);
+            sub(diff, da, cb);
+            square(diff, diff);
+            mul(z3, x1, diff);
+
+            mul(x2, aa, bb);
+            Fe scaled;
+            mulSmall(scaled, e, 121665);
+            add(scaled, aa, scaled);
+            mul(z2, e, scaled);
+        }
+        conditionalSwap(x2, x3, swap);
+        conditionalSwap(z2, z3, swap);
+
+        Fe inverse;
+        invert(inverse, z2);
+        mul(x2, x2, inverse);
+
+        Key out;
+        toBytes(out.data(), x2);
+        std::memset(k, 0, sizeof(k));
+        return out;
+    }
+
+   private:
+    using Fe = std::array<uint64_t, 5>;
+    __extension__ typedef unsigned __int128 Uint128;
+
+    static constexpr uint64_t MASK51 = (1ULL << 51) - 1;
+
+    static uint64_t load64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; --i) {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+
+    static void store64(uint8_t* p, uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+
+    static void fromBytes(Fe& h, const uint8_t* s) {
+        h[0] = load64(s) & MASK51;
+        h[1] = (load64(s + 6) >> 3) & MASK51;
+        h[2] = (load64(s + 12) >> 6) & MASK51;
+        h[3] = (load64(s + 19) >> 1) & MASK51;
+        h[4] = (load64(s + 24) >> 12) & MASK51;  // drops the top bit as RFC 7748 requires
+    }
+
+    static void carry(Fe& h) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < 4; ++i) {
+                h[i + 1] += h[i] >> 51;
+                h[i] &= MASK51;
+            }
+            h[0] += 19 * (h[4] >> 51);
+            h[4] &= MASK51;
+        }
+    }
+
+    static void toBytes(uint8_t* s, Fe h) {
+        carry(h);
+
+        // Subtract p once if h >= p.
+        uint64_t q = (h[0] + 19) >> 51;
+        q = (h[1] + q) >> 51;
+        q = (h[2] + q) >> 51;
+        q = (h[3] + q) >> 51;
+        q = (h[4] + q) >> 51;
+        h[0] += 19 * q;
+        for (int i = 0; i < 4; ++i) {
+            h[i + 1] += h[i] >> 51;
+            h[i] &= MASK51;
+        }
+        h[4] &= MASK51;
+
+        store64(s, h[0] | (h[1] << 51));
+        store64(s + 8, (h[1] >> 13) | (h[2] << 38));
+        store64(s + 16, (h[2] >> 26) | (h[3] << 25));
+        store64(s + 24, (h[3] >> 39) | (h[4] << 12));
+    }
+
+    static void add(Fe& out, const Fe& a, const Fe& b) {
+        for (int i = 0; i < 5; ++i) {
+            out[i] = a[i] + b[i];
+        }
+    }
+
+    // a + 2p - b keeps every limb non-negative.
+    static void sub(Fe& out, const Fe& a, const Fe& b) {
+        out[0] = a[0] + 0xFFFFFFFFFFFDAULL - b[0];
+        for (int i = 1; i < 5; ++i) {
+            out[i] = a[i] + 0xFFFFFFFFFFFFEULL - b[i];
+        }
+        carry(out);
+    }
+
+    static void reduce(Fe& out, Uint128 t0, Uint128 t1, Uint128 t2, Uint128 t3, Uint128 t4) {
+        t1 += static_cast<uint64_t>(t0 >> 51);
+        uint64_t r0 = static_cast<uint64_t>(t0) & MASK51;
+        t2 += static_cast<uint64_t>(t1 >> 51);
+        uint64_t r1 = static_cast<uint64_t>(t1) & MASK51;
+        t3 += static_cast<uint64_t>(t2 >> 51);
+        uint64_t r2 = static_cast<uint64_t>(t2) & MASK51;
+        t4 += static_cast<uint64_t>(t3 >> 51);
+        uint64_t r3 = static_cast<uint64_t>(t3) & MASK51;
+        uint64_t c = static_cast<uint64_t>(t4 >> 51);
+        uint64_t r4 = static_cast<uint64_t>(t4) & MASK51;
+        r0 += c * 19;
+        r1 += r0 >> 51;
+        r0 &= MASK51;
+        out = Fe{r0, r1, r2, r3, r4};
+    }
+
+    static void mul(Fe& out, const Fe& a, const Fe& b) {
+        uint64_t b1_19 = b[1] * 19, b2_19 = b[2] * 19, b3_19 = b[3] * 19, b4_19 = b[4] * 19;
+        auto m = [](uint64_t x, uint64_t y) { return static_cast<Uint128>(x) * y; };
+
+        Uint128 t0 = m(a[0], b[0]) + m(a[1], b4_19) + m(a[2], b3_19) + m(a[3], b2_19) +
+                     m(a[4], b1_19);
+        Uint128 t1 = m(a[0], b[1]) + m(a[1], b[0]) + m(a[2], b4_19) + m(a[3], b3_19) +
+                     m(a[4], b2_19);
+        Uint128 t2 = m(a[0], b[2]) + m(a[1], b[1]) + m(a[2], b[0]) + m(a[3], b4_19) +
+                     m(a[4], b3_19);
+        Uint128 t3 = m(a[0], b[3]) + m(a[1], b[2]) + m(a[2], b[1]) + m(a[3], b[0]) +
+                     m(a[4], b4_19);
+        Uint128 t4 = m(a[0], b[4]) + m(a[1], b[3]) + m(a[2], b[2]) + m(a[3], b[1]) +
+                     m(a[4], b[0]);
+        reduce(out, t0, t1, t2, t3, t4);
+    }
+
+    static void square(Fe& out, const Fe& a) { mul(out, a, a); }
+
+    static void mulSmall(Fe& out, const Fe& a, uint64_t n) {
+        reduce(out, static_cast<Uint128>(a[0]) * n, static_cast<Uint128>(a[1]) * n,
+               static_cast<Uint128>(a[2]) * n, static_cast<Uint128>(a[3]) * n,
+               static_cast<Uint128>(a[4]) * n);
+    }
+
+    static void squareTimes(Fe& out, const Fe& a, int n) {
+        square(out, a);
+        for (int i = 1; i < n; ++i) {
+            square(out, out);
+        }
+    }
+
+    // z^(p - 2) with the usual 2^255 - 21 addition chain.
+    static void invert(Fe& out, const Fe& z) {
+        Fe z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+        square(z2, z);
+        squareTimes(t, z2, 2);
+        mul(z9, t, z);
+        mul(z11, z9, z2);
+        square(t, z11);
+        mul(z2_5_0, t, z9);
+        squareTimes(t, z2_5_0, 5);
+        mul(z2_10_0, t, z2_5_0);
+        squareTimes(t, z2_10_0, 10);
+        mul(z2_20_0, t, z2_10_0);
+        squareTimes(t, z2_20_0, 20);
+        mul(t, t, z2_20_0);
+        squareTimes(t, t, 10);
+        mul(z2_50_0, t, z2_10_0);
+        squareTimes(t, z2_50_0, 50);
+        mul(z2_100_0, t, z2_50_0);
+        squareTimes(t, z2_100_0, 100);
+        mul(t, t, z2_100_0);
+        squareTimes(t, t, 50);
+        mul(t, t, z2_50_0);
+        squareTimes(t, t, 5);
+        mul(out, t, z11);
+    }
+
+    static void conditionalSwap(Fe& a, Fe& b, uint64_t swap) {
+        uint64_t mask = 0 - swap;
+        for (int i = 0; i < 5; ++i) {
+            uint64_t x = mask & (a[i] ^ b[i]);
+            a[i] ^= x;
+            b[i] ^= x;
+        }
+    }
+};
+
+}  // namespace network
@@ -0,0 +1,352 @@
+#include "nat_emulator.hpp"
+#include "../common/protocol.hpp"
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace network {
+
+namespace {
+
+std::string formatAddress(const struct sockaddr_in& addr) {
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+}
+
+struct sockaddr_in makeAddress(const std::string& ip, uint16_t port) {
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0) {
+        throw std::runtime_error("Invalid address: " + ip);
+    }
+    return addr;
+}
+
+}  // namespace
+
+NatEmulator::NatEmulator(const NatEmulatorOptions& options)
+    : options_(options),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      running_(true),
+      next_sequence_(0),
+      random_(options.seed),
+      buffer_(SocketWrapper::MAX_DATAGRAM_SIZE),
+      dropped_(0),
+      filtered_(0) {
+    if (epoll_fd_ < 0) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+    if (options_.nats.empty() || options_.servers.empty()) {
+        close(epoll_fd_);
+        throw std::runtime_error("NAT emulator needs at least one NAT and one server");
+    }
+    if (options_.nats.size() > 254) {
+        close(epoll_fd_);
+        throw std::runtime_error("NAT emulator supports at most 254 NATs");
+    }
+
+    for (const auto& server : options_.servers) {
+        Endpoint address = Protocol::parsePeerInfo(server);
+        if (!address.isIpv4()) {
+            close(epoll_fd_);
+            throw std::runtime_error("NAT emulator servers must be IPv4: " + server);
+        }
+        servers_.push_back(makeAddress(address.ip(), address.port()));
+    }
+
+    for (size_t nat = 0; nat < options_.nats.size(); ++nat) {
+        public_ips_.push_back("127.0.1." + std::to_string(nat + 1));
+        for (size_t server = 0; server < servers_.size(); ++server) {
+            auto socket = std::make_shared<SocketWrapper>(SocketWrapper::Type::UDP,
+                                                          SocketWrapper::Family::IPV4);
+            socket->bind("127.0.0.1", gatewayPort(nat, server));
+            socket->setNonBlocking(true);
+            gateway_ports_.push_back(std::make_unique<Port>(Port{nat, server, nullptr}));
+            watch(socket->getFd(), gateway_ports_.back().get());
+            gateways_.push_back(std::move(socket));
+
+            Logger::info("NAT " + std::to_string(nat) + " (" + natTypeToString(options_.nats[nat]) +
+                         ", public " + public_ips_[nat] + "): " + options_.servers[server] +
+                         " via 127.0.0.1:" + std::to_string(gatewayPort(nat, server)));
+        }
+    }
+}
+
+NatEmulator::~NatEmulator() {
+    close(epoll_fd_);
+}
+
+void NatEmulator::run() {
+    std::vector<struct epoll_event> events(64);
+    auto last_expiry = std::chrono::steady_clock::now();
+
+    while (running_) {
+        int timeout_ms = 1000;
+        if (!deliveries_.empty()) {
+            auto wait = deliveries_.top().due - std::chrono::steady_clock::now();
+            auto wait_ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            timeout_ms = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(wait_ms, timeout_ms)));
+        }
+
+        int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout_ms);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("epoll_wait failed: " + std::string(strerror(errno)));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            receive(*static_cast<Port*>(events[i].data.ptr), now);
+        }
+        flushDeliveries(now);
+
+        if (now - last_expiry >= std::chrono::seconds(1)) {
+            expireBindings(now);
+            last_expiry = now;
+        }
+        retired_.clear();
+    }
+
+    Logger::info("NAT emulator stopped: " + std::to_string(dropped_) + " datagrams lost, " +
+                 std::to_string(filtered_) + " filtered");
+}
+
+NatType NatEmulator::stringToNatType(const std::string& name) {
+    if (name == "full-cone")
+        return NatType::FULL_CONE;
+    if (name == "restricted")
+        return NatType::RESTRICTED;
+    if (name == "port-restricted")
+        return NatType::PORT_RESTRICTED;
+    if (name == "symmetric")
+        return NatType::SYMMETRIC;
+    throw std::runtime_error("Unknown NAT type: " + name);
+}
+
+const char* NatEmulator::natTypeToString(NatType type) {
+    switch (type) {
+        case NatType::FULL_CONE:
+            return "full-cone";
+        case NatType::RESTRICTED:
+            return "restricted";
+        case NatType::PORT_RESTRICTED:
+            return "port-restricted";
+        case NatType::SYMMETRIC:
+            return "symmetric";
+        default:
+            return "unknown";
+    }
+}
+
+void NatEmulator::receive(const Port& port, std::chrono::steady_clock::time_point now) {
+    int fd = port.binding != nullptr
+                 ? port.binding->socket->getFd()
+                 : gateways_[port.nat * servers_.size() + port.server]->getFd();
+
+    while (true) {
+        struct sockaddr_in from{};
+        socklen_t from_len = sizeof(from);
+        ssize_t size = ::recvfrom(fd, buffer_.data(), buffer_.size(), MSG_DONTWAIT,
+                                  reinterpret_cast<struct sockaddr*>(&from), &from_len);
+        if (size < 0) {
+            return;
+        }
+        std::string payload(buffer_.data(), static_cast<size_t>(size));
+
+        auto host = inside_hosts_.find(addressKey(from));
+        if (port.binding == nullptr) {
+            // Whoever talks to NAT i's gateway first is behind NAT i from then on.
+            if (host == inside_hosts_.end()) {
+                host = inside_hosts_.emplace(addressKey(from), port.nat).first;
+                Logger::info("Host " + formatAddress(from) + " is behind NAT " +
+                             std::to_string(port.nat));
+            } else if (host->second != port.nat) {
+                Logger::warning("Host " + formatAddress(from) + " is behind NAT " +
+                                std::to_string(host->second) + ", not " + std::to_string(port.nat));
+                continue;
+            }
+            outbound(port.nat, from, servers_[port.server], std::move(payload), now);
+        } else if (host != inside_hosts_.end()) {
+            // An inside host addressing some NAT's public side: leave through its own NAT.
+            outbound(host->second, from, port.binding->external, std::move(payload), now);
+        } else {
+            size_t server = serverIndex(from);
+            if (server == servers_.size()) {
+                Logger::debug("Dropping datagram from unknown host " + formatAddress(from));
+                continue;
+            }
+            inbound(*port.binding, from, gateways_[port.binding->nat * servers_.size() + server],
+                    std::move(payload), now);
+        }
+    }
+}
+
+void NatEmulator::outbound(size_t nat, const struct sockaddr_in& inside, const struct sockaddr_in& to,
+                           std::string payload, std::chrono::steady_clock::time_point now) {
+    Binding& binding = bindingFor(nat, inside, to, now);
+    binding.last_outbound = now;
+    binding.permissions[addressKey(to)] = now;
+
+    if (serverIndex(to) != servers_.size()) {
+        send(binding.socket, to, std::move(payload), now);
+        return;
+    }
+
+    auto target = by_external_.find(addressKey(to));
+    if (target == by_external_.end()) {
+        Logger::debug("No binding at " + formatAddress(to) + ", dropping datagram");
+        return;
+    }
+    inbound(*target->second, binding.external, binding.socket, std::move(payload), now);
+}
+
+void NatEmulator::inbound(Binding& binding, const struct sockaddr_in& from,
+                          const std::shared_ptr<SocketWrapper>& via, std::string payload,
+                          std::chrono::steady_clock::time_point now) {
+    if (!admits(binding, from, now)) {
+        ++filtered_;
+        Logger::debug("NAT " + std::to_string(binding.nat) + " filtered " + formatAddress(from) +
+                      " -> " + formatAddress(binding.external));
+        return;
+    }
+    // `via` owns the sender's address, so the inside host sees the true source.
+    send(via, binding.inside, std::move(payload), now);
+}
+
+bool NatEmulator::admits(const Binding& binding, const struct sockaddr_in& from,
+                         std::chrono::steady_clock::time_point now) const {
+    if (now - binding.last_outbound > options_.binding_timeout) {
+        return false;
+    }
+
+    NatType type = options_.nats[binding.nat];
+    if (type == NatType::FULL_CONE) {
+        return true;
+    }
+
+    uint64_t key = addressKey(from);
+    for (const auto& [permitted, granted_at] : binding.permissions) {
+        if (now - granted_at > options_.binding_timeout) {
+            continue;
+        }
+        bool match = type == NatType::RESTRICTED ? (permitted >> 16) == (key >> 16) : permitted == key;
+        if (match) {
+            return true;
+        }
+    }
+    return false;
+}
+
+NatEmulator::Binding& NatEmulator::bindingFor(size_t nat, const struct sockaddr_in& inside,
+                                              const struct sockaddr_in& to,
+                                              std::chrono::steady_clock::time_point now) {
+    bool symmetric = options_.nats[nat] == NatType::SYMMETRIC;
+    auto key = std::make_pair(addressKey(inside), symmetric ? addressKey(to) : 0);
+
+    auto it = bindings_.find(key);
+    if (it != bindings_.end() && now - it->second->last_outbound > options_.binding_timeout) {
+        retire(it);  // a real NAT hands out a fresh port once the old binding is gone
+        it = bindings_.end();
+    }
+
+    if (it == bindings_.end()) {
+        auto binding = std::make_unique<Binding>();
+        binding->nat = nat;
+        binding->inside = inside;
+        binding->socket =
+            std::make_shared<SocketWrapper>(SocketWrapper::Type::UDP, SocketWrapper::Family::IPV4);
+        binding->socket->bind(public_ips_[nat], 0);
+        binding->socket->setNonBlocking(true);
+        binding->external = makeAddress(public_ips_[nat], binding->socket->getLocalAddress().port());
+        binding->port = Port{nat, 0, binding.get()};
+        binding->last_outbound = now;
+        watch(binding->socket->getFd(), &binding->port);
+        by_external_[addressKey(binding->external)] = binding.get();
+
+        Logger::info("NAT " + std::to_string(nat) + " mapped " + formatAddress(inside) + " to " +
+                     formatAddress(binding->external) +
+                     (symmetric ? " for " + formatAddress(to) : std::string()));
+        it = bindings_.emplace(key, std::move(binding)).first;
+    }
+    return *it->second;
+}
+
+void NatEmulator::retire(BindingMap::iterator it) {
+    auto& binding = it->second;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, binding->socket->getFd(), nullptr);
+    by_external_.erase(addressKey(binding->external));
+    Logger::info("NAT " + std::to_string(binding->nat) + " binding " +
+                 formatAddress(binding->external) + " expired");
+    retired_.push_back(std::move(binding));
+    bindings_.erase(it);
+}
+
+void NatEmulator::send(const std::shared_ptr<SocketWrapper>& socket, const struct sockaddr_in& to,
+                       std::string payload, std::chrono::steady_clock::time_point now) {
+    if (options_.loss > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(random_) < options_.loss) {
+        ++dropped_;
+        return;
+    }
+    if (options_.delay.count() == 0) {
+        transmit(*socket, to, payload);
+        return;
+    }
+    deliveries_.push(Delivery{now + options_.delay, next_sequence_++, socket, to, std::move(payload)});
+}
+
+void NatEmulator::transmit(const SocketWrapper& socket, const struct sockaddr_in& to,
+                           const std::string& payload) {
+    if (::sendto(socket.getFd(), payload.data(), payload.size(), MSG_DONTWAIT,
+                 reinterpret_cast<const struct sockaddr*>(&to), sizeof(to)) < 0) {
+        Logger::debug("Failed to deliver to " + formatAddress(to) + ": " + strerror(errno));
+    }
+}
+
+void NatEmulator::flushDeliveries(std::chrono::steady_clock::time_point now) {
+    while (!deliveries_.empty() && deliveries_.top().due <= now) {
+        const Delivery& delivery = deliveries_.top();
+        transmit(*delivery.socket, delivery.to, delivery.payload);
+        deliveries_.pop();
+    }
+}
+
+void NatEmulator::expireBindings(std::chrono::steady_clock::time_point now) {
+    for (auto it = bindings_.begin(); it != bindings_.end();) {
+        auto next = std::next(it);
+        if (now - it->second->last_outbound > options_.binding_timeout) {
+            retire(it);
+        }
+        it = next;
+    }
+}
+
+void NatEmulator::watch(int fd, Port* port) {
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = port;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        throw std::runtime_error("Failed to watch emulator socket");
+    }
+}
+
+size_t NatEmulator::serverIndex(const struct sockaddr_in& addr) const {
+    for (size_t i = 0; i < servers_.size(); ++i) {
+        if (servers_[i].sin_port == addr.sin_port &&
+            servers_[i].sin_addr.s_addr == addr.sin_addr.s_addr) {
+            return i;
+        }
+    }
+    return servers_.size();
+}
+
+uint64_t NatEmulator::addressKey(const struct sockaddr_in& addr) {
+    return (static_cast<uint64_t>(ntohl(addr.sin_addr.s_addr)) << 16) | ntohs(addr.sin_port);
+}
+
+}  // namespace network
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "../common/socket_wrapper.hpp"
+#include "../common/logger.hpp"
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace network {
+
+enum class NatType { FULL_CONE, RESTRICTED, PORT_RESTRICTED, SYMMETRIC };
+
+struct NatEmulatorOptions {
+    std::vector<NatType> nats;         // NAT i gets public address 127.0.1.<i + 1>
+    std::vector<std::string> servers;  // "ip:port" of public servers, e.g. the rendezvous
+    uint16_t base_port = 9600;         // see NatEmulator::gatewayPort
+    std::chrono::milliseconds binding_timeout{30000};
+    double loss = 0;                      // drop probability per datagram
+    std::chrono::microseconds delay{0};  // one-way delay per datagram
+    uint32_t seed = 1;                    // loss is reproducible for a given seed
+};
+
+// Userspace NAT emulator for localhost tests. Every address a client behind NAT i can
+// talk to is owned by this process: gateway sockets stand in for the public servers,
+// and the external side of every NAT binding is a socket on the NAT's public address.
+// A client is placed behind NAT i by pointing it at NAT i's gateway for the
+// rendezvous. Datagrams from an inside host to a NAT's external address are routed
+// through the sender's NAT and then the receiver's, so two clients punching holes
+// through each other's bindings see exactly the addresses and filtering a pair of real
+// NATs would give them:
+//
+//   full-cone        one binding per inside endpoint, anyone may send to it
+//   restricted       one binding per inside endpoint, only IPs it has sent to
+//   port-restricted  one binding per inside endpoint, only ip:ports it has sent to
+//   symmetric        one binding per inside endpoint and destination, only that destination
+//
+// Bindings expire after binding_timeout without outbound traffic. NAT is an IPv4 affair,
+// so the emulator uses IPv4-only sockets and plain sockaddr_in throughout.
+class NatEmulator {
+   public:
+    explicit NatEmulator(const NatEmulatorOptions& options);
+    ~NatEmulator();
+    void run();
+    void stop() { running_ = false; }
+
+    // Port of NAT `nat`'s stand-in for server `server`, on 127.0.0.1.
+    uint16_t gatewayPort(size_t nat, size_t server) const {
+        return static_cast<uint16_t>(options_.base_port + nat * options_.servers.size() + server);
+    }
+
+    static NatType stringToNatType(const std::string& name);
+    static const char* natTypeToString(NatType type);
+
+   private:
+    struct Binding;
+
+    // What an epoll event refers to: a gateway (binding == nullptr) or a binding.
+    struct Port {
+        size_t nat;
+        size_t server;
+        Binding* binding;
+    };
+
+    struct Binding {
+        size_t nat;
+        struct sockaddr_in inside;
+        struct sockaddr_in external;
+        std::shared_ptr<SocketWrapper> socket;  // shared with queued deliveries
+        Port port;
+        std::map<uint64_t, std::chrono::steady_clock::time_point> permissions;  // by addressKey
+        std::chrono::steady_clock::time_point last_outbound;
+    };
+
+    struct Delivery {
+        std::chrono::steady_clock::time_point due;
+        uint64_t sequence;  // keeps datagrams with the same due time in order
+        std::shared_ptr<SocketWrapper> socket;
+        struct sockaddr_in to;
+        std::string payload;
+
+        bool operator>(const Delivery& other) const {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    using BindingMap = std::map<std::pair<uint64_t, uint64_t>, std::unique_ptr<Binding>>;
+
+    void receive(const Port& port, std::chrono::steady_clock::time_point now);
+    void outbound(size_t nat, const struct sockaddr_in& inside, const struct sockaddr_in& to,
+                  std::string payload, std::chrono::steady_clock::time_point now);
+    void inbound(Binding& binding, const struct sockaddr_in& from,
+                 const std::shared_ptr<SocketWrapper>& via, std::string payload,
+                 std::chrono::steady_clock::time_point now);
+    bool admits(const Binding& binding, const struct sockaddr_in& from,
+                std::chrono::steady_clock::time_point now) const;
+    Binding& bindingFor(size_t nat, const struct sockaddr_in& inside, const struct sockaddr_in& to,
+                        std::chrono::steady_clock::time_point now);
+    void retire(BindingMap::iterator it);
+    void send(const std::shared_ptr<SocketWrapper>& socket, const struct sockaddr_in& to,
+              std::string payload, std::chrono::steady_clock::time_point now);
+    void transmit(const SocketWrapper& socket, const struct sockaddr_in& to, const std::string& payload);
+    void flushDeliveries(std::chrono::steady_clock::time_point now);
+    void expireBindings(std::chrono::steady_clock::time_point now);
+    void watch(int fd, Port* port);
+    size_t serverIndex(const struct sockaddr_in& addr) const;
+
+    static uint64_t addressKey(const struct sockaddr_in& addr);
+
+    NatEmulatorOptions options_;
+    int epoll_fd_;
+    std::atomic<bool> running_;
+    std::vector<struct sockaddr_in> servers_;
+    std::vector<std::shared_ptr<SocketWrapper>> gateways_;  // nat * servers + server
+    std::vector<std::unique_ptr<Port>> gateway_ports_;
+    std::vector<std::string> public_ips_;
+    std::map<uint64_t, size_t> inside_hosts_;  // inside endpoint -> NAT
+    BindingMap bindings_;  // (inside endpoint, destination if symmetric else 0) -> binding
+    std::map<uint64_t, Binding*> by_external_;
+    // Expired bindings live until the end of the event batch that may still name them.
+    std::vector<std::unique_ptr<Binding>> retired_;
+    std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> deliveries_;
+    uint64_t next_sequence_;
+    std::mt19937 random_;
+    std::vector<char> buffer_;
+    uint64_t dropped_;
+    uint64_t filtered_;
+};
+
+}  // namespace network
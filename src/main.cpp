@@ -1,29 +1,146 @@
 #include "rendezvous/rendezvous_server.hpp"
+#include "rendezvous/cluster_harness.hpp"
+#include "rendezvous/relay_server.hpp"
+#include "emulator/nat_emulator.hpp"
+#include "replay/replay_harness.hpp"
 #include "p2p/p2p_client.hpp"
 #include "common/logger.hpp"
+#include "common/dictionary_trainer.hpp"
+#include "common/io_thread.hpp"
+#include "common/tracing.hpp"
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
 struct Config {
     std::string mode;
-    std::string address = "0.0.0.0";
+    std::string address = "::";
     uint16_t port = 8080;
+    network::SocketOptions socket_options;
+    network::IoBackend io_backend = network::IoBackend::EPOLL;
+    bool mtu_probing = true;
+    size_t max_datagram_size = network::PathMtuProber::ETHERNET_DATAGRAM_SIZE;
+    bool compression = true;
+    std::string dictionary_path;
+    bool encryption = true;
+    std::string samples_path;
+    size_t dictionary_size = 16 * 1024;
+    uint32_t rate_limit = 50;
+    uint32_t rate_burst = 100;
+    size_t max_peers = 4096;
+    size_t max_peers_per_ip = 32;
+    std::vector<std::string> cluster_members;
+    std::string cluster_self;
+    std::optional<network::SipHash::Key> cluster_key;
+    std::string room;
+    std::string relay_address;
+    size_t max_sessions = 1024;
+    std::vector<std::string> nat_types;
+    std::vector<std::string> servers;
+    uint32_t binding_timeout_ms = 30000;
+    double loss = 0;
+    double delay_ms = 0;
+    uint32_t seed = 1;
+    std::string capture_path;
+    std::string handover_path;
+    std::string replay_target = "rendezvous";
+    double replay_speed = 0;
+    size_t harness_nodes = 3;
+    size_t harness_pairs = 200;
+    network::IoThreadOptions io_thread;
+    std::string trace_path;
 };
 
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
 void printUsage(const char* program_name) {
     std::cerr << "Usage: " << program_name << " <mode> [options]\n";
     std::cerr << "Modes:\n";
     std::cerr << "  rendezvous    - Start rendezvous server\n";
     std::cerr << "  p2p-client    - Start P2P client\n";
+    std::cerr << "  relay         - Start relay server for peers that cannot punch through\n";
+    std::cerr << "  nat-emulator  - Emulate NATs on localhost between clients and servers\n";
+    std::cerr << "  replay        - Feed a --capture file into the rendezvous or client handlers\n";
+    std::cerr << "  train-dict    - Train a compression dictionary from sample messages\n";
+    std::cerr << "  cluster-bench - Run a local rendezvous cluster and measure cross-node pairing\n";
     std::cerr << "\nOptions:\n";
-    std::cerr << "  --address <ip>      Server address (default: 0.0.0.0)\n";
+    std::cerr << "  --address <ip>      Server address (default: ::, dual-stack)\n";
     std::cerr << "  --port <port>       Server port (default: 8080)\n";
     std::cerr << "  --rendezvous <ip>   Rendezvous server address (for p2p-client)\n";
     std::cerr << "  --rendezvous-port <port>  Rendezvous server port (for p2p-client, default: 8080)\n";
+    std::cerr << "  --io-backend <name> Datagram I/O backend: epoll, io_uring (default: epoll)\n";
+    std::cerr << "  --max-datagram <bytes>  Largest UDP payload probed on the P2P path (default: 1472)\n";
+    std::cerr << "  --no-mtu-probe      Disable path MTU probing, send 1200 byte fragments\n";
+    std::cerr << "  --no-compression    Do not offer LZ4 message compression to the peer\n";
+    std::cerr << "  --dict <file>       Shared compression dictionary (output file for train-dict)\n";
+    std::cerr << "  --no-encryption     Send P2P traffic in the clear (the peer must agree)\n";
+    std::cerr << "  --samples <file>    Sample messages for train-dict, one per line\n";
+    std::cerr << "  --dict-size <bytes> Dictionary size for train-dict (default: 16384)\n";
+    std::cerr << "  --rate-limit <pps>  Per-source packet rate at the rendezvous, 0 = off (default: 50)\n";
+    std::cerr << "  --rate-burst <n>    Per-source burst allowance at the rendezvous (default: 100)\n";
+    std::cerr << "  --max-peers <n>     Registrations the rendezvous holds at once (default: 4096)\n";
+    std::cerr << "  --max-peers-per-ip <n>  Of those, from one source IP, 0 = unlimited (default: 32)\n";
+    std::cerr << "  --cluster <list>    Comma-separated ip:port of every rendezvous node in the cluster\n";
+    std::cerr << "  --node <ip:port>    This node's entry in --cluster (default: address:port)\n";
+    std::cerr << "  --cluster-key <hex> Secret shared by the --cluster nodes, 32 hex characters\n";
+    std::cerr << "  --room <name>       Rendezvous room; only peers in the same room are paired\n";
+    std::cerr << "  --relay <ip:port>   Relay to fall back to when hole punching fails (for p2p-client)\n";
+    std::cerr << "  --max-sessions <n>  Relay sessions held at once (default: 1024)\n";
+    std::cerr << "  --nat <list>        NAT types for nat-emulator: full-cone, restricted, port-restricted, symmetric\n";
+    std::cerr << "  --servers <list>    Public ip:port servers reachable through nat-emulator gateways\n";
+    std::cerr << "  --binding-timeout <ms>  NAT binding lifetime without outbound traffic (default: 30000)\n";
+    std::cerr << "  --loss <p>          nat-emulator drop probability per datagram (default: 0)\n";
+    std::cerr << "  --delay <ms>        nat-emulator one-way delay per datagram (default: 0)\n";
+    std::cerr << "  --seed <n>          nat-emulator loss seed (default: 1)\n";
+    std::cerr << "  --capture <file>    Record received datagrams (rendezvous, p2p-client); input for replay\n";
+    std::cerr << "  --handover <path>   Unix socket for zero-downtime restarts of the rendezvous\n";
+    std::cerr << "  --target <name>     Replay into: rendezvous, p2p-client (default: rendezvous)\n";
+    std::cerr << "  --speed <x>         Replay pace relative to the recording, 0 = unthrottled (default: 0)\n";
+    std::cerr << "  --nodes <n>         Cluster size for cluster-bench, from --port upwards (default: 3)\n";
+    std::cerr << "  --pairs <n>         Client pairs for cluster-bench (default: 200)\n";
+    std::cerr << "  --cpus <list>       Pin the I/O threads to cores, e.g. 2 or 2-3 (rendezvous, p2p-client)\n";
+    std::cerr << "  --spin              Busy poll without sleeping, with SO_BUSY_POLL (rendezvous, p2p-client)\n";
+    std::cerr << "  --trace <file>      Write timing spans as Chrome trace-event JSON (rendezvous, p2p-client)\n";
+    std::cerr << "\nSocket options (both modes):\n";
+    std::cerr << "  --rcvbuf <bytes>    Receive buffer size (SO_RCVBUF)\n";
+    std::cerr << "  --sndbuf <bytes>    Send buffer size (SO_SNDBUF)\n";
+    std::cerr << "  --force-buffers     Use SO_RCVBUFFORCE/SO_SNDBUFFORCE (needs CAP_NET_ADMIN)\n";
+    std::cerr << "  --busy-poll <usec>  Busy poll budget for blocking receives (SO_BUSY_POLL)\n";
+    std::cerr << "  --tos <value>       IP_TOS byte\n";
+    std::cerr << "  --dscp <value>      DSCP code point, shorthand for --tos <value << 2>\n";
+    std::cerr << "  --timestamping      Kernel receive timestamps for RTT measurement\n";
+    std::cerr << "  --pmtu <mode>       IP_MTU_DISCOVER mode: do, dont, want, probe\n";
+    std::cerr << "  --gso <bytes>       UDP GSO segment size for batched sends\n";
+    std::cerr << "  --gro               Enable UDP GRO on receive\n";
     std::cerr << "  --help              Show this help message\n";
 }
 
+network::SocketOptions::PmtuDiscovery parsePmtuMode(const std::string& mode) {
+    if (mode == "do")
+        return network::SocketOptions::PmtuDiscovery::DO;
+    if (mode == "dont")
+        return network::SocketOptions::PmtuDiscovery::DONT;
+    if (mode == "want")
+        return network::SocketOptions::PmtuDiscovery::WANT;
+    if (mode == "probe")
+        return network::SocketOptions::PmtuDiscovery::PROBE;
+    throw std::runtime_error("Invalid PMTU discovery mode: " + mode);
+}
+
 Config parseArguments(int argc, char* argv[]) {
     Config config;
 
@@ -49,6 +166,92 @@ Config parseArguments(int argc, char* argv[]) {
             config.address = argv[++i];
         } else if (arg == "--rendezvous-port" && i + 1 < argc) {
             config.port = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "--io-backend" && i + 1 < argc) {
+            config.io_backend = network::DatagramIo::stringToBackend(argv[++i]);
+        } else if (arg == "--max-datagram" && i + 1 < argc) {
+            config.max_datagram_size = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--no-mtu-probe") {
+            config.mtu_probing = false;
+        } else if (arg == "--no-compression") {
+            config.compression = false;
+        } else if (arg == "--no-encryption") {
+            config.encryption = false;
+        } else if (arg == "--dict" && i + 1 < argc) {
+            config.dictionary_path = argv[++i];
+        } else if (arg == "--samples" && i + 1 < argc) {
+            config.samples_path = argv[++i];
+        } else if (arg == "--dict-size" && i + 1 < argc) {
+            config.dictionary_size = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--rate-limit" && i + 1 < argc) {
+            config.rate_limit = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--rate-burst" && i + 1 < argc) {
+            config.rate_burst = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--max-peers" && i + 1 < argc) {
+            config.max_peers = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--max-peers-per-ip" && i + 1 < argc) {
+            config.max_peers_per_ip = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--cluster" && i + 1 < argc) {
+            config.cluster_members = splitList(argv[++i]);
+        } else if (arg == "--node" && i + 1 < argc) {
+            config.cluster_self = argv[++i];
+        } else if (arg == "--cluster-key" && i + 1 < argc) {
+            config.cluster_key = network::Cluster::parseKey(argv[++i]);
+        } else if (arg == "--room" && i + 1 < argc) {
+            config.room = argv[++i];
+        } else if (arg == "--relay" && i + 1 < argc) {
+            config.relay_address = argv[++i];
+        } else if (arg == "--max-sessions" && i + 1 < argc) {
+            config.max_sessions = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--nat" && i + 1 < argc) {
+            config.nat_types = splitList(argv[++i]);
+        } else if (arg == "--servers" && i + 1 < argc) {
+            config.servers = splitList(argv[++i]);
+        } else if (arg == "--binding-timeout" && i + 1 < argc) {
+            config.binding_timeout_ms = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--loss" && i + 1 < argc) {
+            config.loss = std::stod(argv[++i]);
+        } else if (arg == "--delay" && i + 1 < argc) {
+            config.delay_ms = std::stod(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            config.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--capture" && i + 1 < argc) {
+            config.capture_path = argv[++i];
+        } else if (arg == "--handover" && i + 1 < argc) {
+            config.handover_path = argv[++i];
+        } else if (arg == "--target" && i + 1 < argc) {
+            config.replay_target = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            config.replay_speed = std::stod(argv[++i]);
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            config.harness_nodes = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--pairs" && i + 1 < argc) {
+            config.harness_pairs = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--cpus" && i + 1 < argc) {
+            config.io_thread.cpus = network::IoThreadOptions::parseCpuList(argv[++i]);
+        } else if (arg == "--spin") {
+            config.io_thread.busy_poll = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            config.trace_path = argv[++i];
+        } else if (arg == "--rcvbuf" && i + 1 < argc) {
+            config.socket_options.recv_buffer = std::stoi(argv[++i]);
+        } else if (arg == "--sndbuf" && i + 1 < argc) {
+            config.socket_options.send_buffer = std::stoi(argv[++i]);
+        } else if (arg == "--force-buffers") {
+            config.socket_options.force_buffers = true;
+        } else if (arg == "--busy-poll" && i + 1 < argc) {
+            config.socket_options.busy_poll_us = std::stoi(argv[++i]);
+        } else if (arg == "--tos" && i + 1 < argc) {
+            config.socket_options.tos = std::stoi(argv[++i], nullptr, 0);
+        } else if (arg == "--dscp" && i + 1 < argc) {
+            config.socket_options.tos = std::stoi(argv[++i], nullptr, 0) << 2;
+        } else if (arg == "--timestamping") {
+            config.socket_options.timestamping = true;
+        } else if (arg == "--pmtu" && i + 1 < argc) {
+            config.socket_options.pmtu = parsePmtuMode(argv[++i]);
+        } else if (arg == "--gso" && i + 1 < argc) {
+            config.socket_options.gso_segment = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "--gro") {
+            config.socket_options.gro = true;
         } else if (arg == "--help") {
             printUsage(argv[0]);
             exit(0);
@@ -58,26 +261,127 @@ Config parseArguments(int argc, char* argv[]) {
     return config;
 }
 
+void trainDictionary(const Config& config) {
+    if (config.samples_path.empty() || config.dictionary_path.empty()) {
+        throw std::runtime_error("train-dict requires --samples and --dict");
+    }
+
+    std::ifstream samples_file(config.samples_path);
+    if (!samples_file) {
+        throw std::runtime_error("Failed to open samples file: " + config.samples_path);
+    }
+
+    std::vector<std::string> samples;
+    std::string line;
+    while (std::getline(samples_file, line)) {
+        if (!line.empty()) {
+            samples.push_back(line);
+        }
+    }
+
+    std::string dictionary = network::DictionaryTrainer::train(samples, config.dictionary_size);
+
+    std::ofstream dictionary_file(config.dictionary_path, std::ios::binary);
+    if (!dictionary_file.write(dictionary.data(), static_cast<std::streamsize>(dictionary.size()))) {
+        throw std::runtime_error("Failed to write dictionary: " + config.dictionary_path);
+    }
+
+    network::Logger::info("Trained " + std::to_string(dictionary.size()) +
+                          " byte dictionary from " + std::to_string(samples.size()) + " samples");
+}
+
 int main(int argc, char* argv[]) {
     try {
         Config config = parseArguments(argc, argv);
+        if (!config.trace_path.empty()) {
+            network::Tracer::enable(config.trace_path);
+        }
 
         if (config.mode == "rendezvous") {
-            network::RendezvousServer server(config.address, config.port);
+            network::RendezvousServerOptions options;
+            options.socket = config.socket_options;
+            options.io_backend = config.io_backend;
+            options.rate_limit = config.rate_limit;
+            options.rate_burst = config.rate_burst;
+            options.max_peers = config.max_peers;
+            options.max_peers_per_ip = config.max_peers_per_ip;
+            options.cluster_members = config.cluster_members;
+            options.cluster_self = config.cluster_self;
+            options.cluster_key = config.cluster_key;
+            options.capture_path = config.capture_path;
+            options.handover_path = config.handover_path;
+            options.io_thread = config.io_thread;
+
+            network::RendezvousServer server(config.address, config.port, options);
             server.run();
         } else if (config.mode == "p2p-client") {
-            network::P2PClient client(config.address, config.port);
+            network::P2PClientOptions options;
+            options.socket = config.socket_options;
+            options.io_backend = config.io_backend;
+            options.mtu_probing = config.mtu_probing;
+            options.max_datagram_size = config.max_datagram_size;
+            options.compression = config.compression;
+            options.dictionary_path = config.dictionary_path;
+            options.encryption = config.encryption;
+            options.room = config.room;
+            options.relay_address = config.relay_address;
+            options.capture_path = config.capture_path;
+            options.io_thread = config.io_thread;
+
+            network::P2PClient client(config.address, config.port, options);
             client.run();
+        } else if (config.mode == "relay") {
+            network::RelayServerOptions options;
+            options.socket = config.socket_options;
+            options.max_sessions = config.max_sessions;
+            options.rate_limit = config.rate_limit;
+            options.rate_burst = config.rate_burst;
+
+            network::RelayServer server(config.address, config.port, options);
+            server.run();
+        } else if (config.mode == "nat-emulator") {
+            network::NatEmulatorOptions options;
+            for (const auto& type : config.nat_types) {
+                options.nats.push_back(network::NatEmulator::stringToNatType(type));
+            }
+            options.servers = config.servers;
+            options.base_port = config.port;
+            options.binding_timeout = std::chrono::milliseconds(config.binding_timeout_ms);
+            options.loss = config.loss;
+            options.delay = std::chrono::microseconds(static_cast<int64_t>(config.delay_ms * 1000));
+            options.seed = config.seed;
+
+            network::NatEmulator emulator(options);
+            emulator.run();
+        } else if (config.mode == "replay") {
+            network::ReplayOptions options;
+            options.capture_path = config.capture_path;
+            options.target = config.replay_target;
+            options.speed = config.replay_speed;
+            options.encryption = config.encryption;
+            options.compression = config.compression;
+            network::runReplay(options);
+        } else if (config.mode == "train-dict") {
+            trainDictionary(config);
+        } else if (config.mode == "cluster-bench") {
+            network::ClusterHarnessOptions options;
+            options.nodes = config.harness_nodes;
+            options.pairs = config.harness_pairs;
+            options.base_port = config.port;
+            options.io_backend = config.io_backend;
+            network::runClusterHarness(options);
         } else {
             throw std::runtime_error("Invalid mode: " + config.mode);
         }
 
     } catch (const std::exception& e) {
+        network::Tracer::flush();
         std::cerr << "Error: " << e.what() << std::endl;
         std::cerr << "Use --help for usage information" << std::endl;
         return 1;
     }
 
+    network::Tracer::flush();
     return 0;
 }
 
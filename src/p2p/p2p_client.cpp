@@ -1,29 +1,61 @@
 #include "p2p_client.hpp"
+#include "../common/capture.hpp"
+#include "../common/io_backend.hpp"
+#include "../common/tracing.hpp"
 
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <thread>
 
 namespace network {
 
-P2PClient::P2PClient(const std::string& rendezvous_address, uint16_t rendezvous_port)
-    : rendezvous_address_(rendezvous_address),
-      rendezvous_port_(rendezvous_port),
+namespace {
+
+std::string loadDictionary(const std::string& path) {
+    if (path.empty()) {
+        return "";
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open compression dictionary: " + path);
+    }
+    std::string dictionary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Logger::info("Loaded " + std::to_string(dictionary.size()) + " byte compression dictionary");
+    return dictionary;
+}
+
+}  // namespace
+
+P2PClient::P2PClient(const std::string& rendezvous_address, uint16_t rendezvous_port,
+                     const P2PClientOptions& options)
+    : rendezvous_(rendezvous_address, rendezvous_port),
+      options_(options),
       connected_(false),
-      running_(true) {
-    Logger::info("P2P client initialized, rendezvous: " + rendezvous_address + ":" +
-                 std::to_string(rendezvous_port));
+      running_(true),
+      ping_sent_ns_(0),
+      fragmenter_(PathMtuProber::BASE_DATAGRAM_SIZE -
+                  (options.encryption ? SecureChannel::OVERHEAD : 0)),
+      mtu_prober_(options.max_datagram_size),
+      compressor_(options.compression, loadDictionary(options.dictionary_path)),
+      secure_channel_(options.encryption) {
+    Logger::info("P2P client initialized, rendezvous: " + rendezvous_.toString());
 }
 
 void P2PClient::run() {
     try {
+        // The receiver thread inherits the cores and the node-local memory policy, and
+        // the sockets and buffers are allocated after this.
+        placeCurrentThread(options_.io_thread, "P2P client");
+        Tracer::nameThread("P2P client");
         connectToRendezvous();
         registerWithRendezvous();
         waitForPeerInfo();
 
-        if (!peer_ip_.empty() && peer_port_ != 0) {
-            performHolePunching(peer_ip_, peer_port_);
-            startP2PCommunication(peer_ip_, peer_port_);
+        if (!peer_.empty()) {
+            performHolePunching(peer_);
+            startP2PCommunication(peer_);
         } else {
             Logger::error("Failed to get peer information");
         }
@@ -34,17 +66,19 @@ void P2PClient::run() {
 }
 
 void P2PClient::connectToRendezvous() {
+    TraceSpan span("connect", "client");
     rendezvous_socket_ = std::make_unique<SocketWrapper>(SocketWrapper::Type::UDP);
+    rendezvous_socket_->applyOptions(options_.socket);
     rendezvous_socket_->bind(0);
 
-    auto [local_ip, local_port] = rendezvous_socket_->getLocalAddress();
-    Logger::info("Connected to rendezvous server, local: " + local_ip + ":" +
-                 std::to_string(local_port));
+    Logger::info("Connected to rendezvous server, local: " +
+                 rendezvous_socket_->getLocalAddress().toString());
 }
 
 void P2PClient::registerWithRendezvous() {
-    std::string register_msg = Protocol::serialize(Command::REGISTER);
-    rendezvous_socket_->sendto(register_msg, rendezvous_address_, rendezvous_port_);
+    TraceSpan span("register", "client");
+    std::string register_msg = Protocol::createCookieRequest();
+    rendezvous_socket_->sendto(register_msg, rendezvous_);
 
     Logger::info("Registered with rendezvous server");
 
@@ -56,17 +90,26 @@ void P2PClient::registerWithRendezvous() {
     while (!response_received && std::chrono::steady_clock::now() < timeout) {
         try {
             auto [response, sender_info] = rendezvous_socket_->receivefrom();
+            if (sender_info != rendezvous_) {
+                continue;  // anyone who learns our port could otherwise answer for the server
+            }
             auto [cmd, data] = Protocol::parse(response);
 
-            if (cmd == Command::REGISTER) {
+            if (cmd == Command::COOKIE) {
+                TraceSpan cookie_span("answer_cookie", "client");
+                // Echo the cookie to prove we receive at our address; the server keeps
+                // no state for us until then.
+                rendezvous_socket_->sendto(Protocol::createRegister(data, "", options_.room),
+                                           rendezvous_);
+                Logger::debug("Answered registration cookie");
+            } else if (cmd == Command::REGISTER) {
                 Logger::info("Registration confirmed: " + data);
                 response_received = true;
             } else if (cmd == Command::PEER_INFO) {
-                auto [peer_ip, peer_port] = Protocol::parsePeerInfo(data);
-                peer_ip_ = peer_ip;
-                peer_port_ = peer_port;
-                Logger::info("Received peer info early: " + peer_ip_ + ":" +
-                             std::to_string(peer_port_));
+                peer_ = Protocol::parsePeerInfo(data);
+                session_id_ = Protocol::parsePeerSession(data);
+                Tracer::setSession(session_id_);
+                Logger::info("Received peer info early: " + peer_.toString());
                 response_received = true;
             } else {
                 Logger::warning("Unexpected response from rendezvous: " + response);
@@ -86,8 +129,9 @@ void P2PClient::registerWithRendezvous() {
 }
 
 void P2PClient::waitForPeerInfo() {
-    if (!peer_ip_.empty() && peer_port_ != 0) {
-        Logger::info("Peer info already received: " + peer_ip_ + ":" + std::to_string(peer_port_));
+    TraceSpan span("peer_info_wait", "client");
+    if (!peer_.empty()) {
+        Logger::info("Peer info already received: " + peer_.toString());
         return;
     }
 
@@ -101,14 +145,17 @@ void P2PClient::waitForPeerInfo() {
     while (!peer_info_received && std::chrono::steady_clock::now() < timeout) {
         try {
             auto [response, sender_info] = rendezvous_socket_->receivefrom();
+            if (sender_info != rendezvous_) {
+                continue;  // a PEER_INFO from anyone else would steer the handshake
+            }
             auto [cmd, data] = Protocol::parse(response);
 
             if (cmd == Command::PEER_INFO) {
-                auto [peer_ip, peer_port] = Protocol::parsePeerInfo(data);
-                peer_ip_ = peer_ip;
-                peer_port_ = peer_port;
+                peer_ = Protocol::parsePeerInfo(data);
+                session_id_ = Protocol::parsePeerSession(data);
+                Tracer::setSession(session_id_);
                 peer_info_received = true;
-                Logger::info("Received peer info: " + peer_ip_ + ":" + std::to_string(peer_port_));
+                Logger::info("Received peer info: " + peer_.toString());
                 break;
             }
         } catch (const std::runtime_error& e) {
@@ -130,17 +177,50 @@ void P2PClient::waitForPeerInfo() {
     }
 }
 
-void P2PClient::performHolePunching(const std::string& peer_ip, uint16_t peer_port) {
-    Logger::info("Starting NAT hole punching to " + peer_ip + ":" + std::to_string(peer_port));
-
-    p2p_socket_ = std::make_unique<SocketWrapper>(SocketWrapper::Type::UDP);
-    p2p_socket_->bind(0);
-
-    sendHolePunchPackets(peer_ip, peer_port, 10);
+void P2PClient::performHolePunching(const Endpoint& peer) {
+    TraceSpan span("hole_punch", "client");
+    // IPv6 addresses are global: there is no NAT binding to open, only the handshake
+    // carrying the keys and capabilities, so the spaced punching burst is skipped.
+    bool traverse_nat = !peer.isIpv6();
+    Logger::info((traverse_nat ? "Starting NAT hole punching to " : "Contacting IPv6 peer directly at ") +
+                 peer.toString());
+    auto started = std::chrono::steady_clock::now();
+
+    // The peer was told the public address the rendezvous saw for our registration
+    // socket, so that socket (and its NAT mapping) has to carry the P2P traffic.
+    p2p_socket_ = std::move(rendezvous_socket_);
+    if (options_.mtu_probing && options_.socket.pmtu == SocketOptions::PmtuDiscovery::DEFAULT) {
+        // DF on every datagram and no kernel PMTU clamping: probe sizes are ours to pick.
+        p2p_socket_->setMtuDiscover(SocketOptions::PmtuDiscovery::PROBE);
+    }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    TraceSpan punch_span("punch", "client");
+    if (traverse_nat) {
+        sendHolePunchPackets(peer, 10, std::chrono::milliseconds(50));
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    } else {
+        // A few back-to-back copies only guard the handshake against loss.
+        sendHolePunchPackets(peer, 3, std::chrono::milliseconds(0));
+    }
+    punch_span.end();
+
+    // Ends when the first packet from the peer arrives, or on giving up.
+    TraceSpan first_packet_span("first_packet", "client");
+    bool connection_established = establishConnection(peer);
+    first_packet_span.end();
+
+    const char* path = "direct";
+    if (!connection_established && !options_.relay_address.empty()) {
+        TraceSpan relay_span("relay_fallback", "client");
+        connection_established = connectViaRelay();
+        path = "relay";
+    }
 
-    bool connection_established = establishConnection(peer_ip, peer_port);
+    // Parsed by scripts/nat_matrix.sh.
+    double setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                started).count();
+    Logger::info("Connection setup: " + std::string(connection_established ? path : "failed") +
+                 " after " + std::to_string(setup_ms) + " ms");
 
     if (!connection_established) {
         Logger::warning("Direct connection may not be established, continuing anyway...");
@@ -149,22 +229,27 @@ void P2PClient::performHolePunching(const std::string& peer_ip, uint16_t peer_po
     connected_ = true;
 }
 
-void P2PClient::sendHolePunchPackets(const std::string& peer_ip, uint16_t peer_port, int count) {
-    std::string punch_msg = Protocol::serialize(Command::HOLE_PUNCH);
+void P2PClient::sendHolePunchPackets(const Endpoint& peer, int count, std::chrono::milliseconds interval) {
+    std::string capabilities = compressor_.getCapabilities();
+    std::string key_capability = secure_channel_.getCapabilities();
+    if (!key_capability.empty()) {
+        capabilities += (capabilities.empty() ? "" : ";") + key_capability;
+    }
+    std::string punch_msg = Protocol::serialize(Command::HOLE_PUNCH, capabilities);
 
     for (int i = 0; i < count; ++i) {
         try {
-            p2p_socket_->sendto(punch_msg, peer_ip, peer_port);
+            p2p_socket_->sendto(punch_msg, peer);
             Logger::debug("Sent hole punch packet " + std::to_string(i + 1) + "/" +
                           std::to_string(count));
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            std::this_thread::sleep_for(interval);
         } catch (const std::exception& e) {
             Logger::error("Failed to send hole punch packet: " + std::string(e.what()));
         }
     }
 }
 
-bool P2PClient::establishConnection(const std::string& peer_ip, uint16_t peer_port) {
+bool P2PClient::establishConnection(const Endpoint& peer) {
     Logger::info("Attempting to establish connection with peer...");
 
     p2p_socket_->setNonBlocking(true);
@@ -173,16 +258,21 @@ bool P2PClient::establishConnection(const std::string& peer_ip, uint16_t peer_po
 
     while (std::chrono::steady_clock::now() < timeout) {
         try {
-            auto [response, sender_info] = p2p_socket_->receivefrom();
-            auto [sender_ip, sender_port] = sender_info;
+            auto [response, sender] = p2p_socket_->receivefrom();
 
-            if (sender_ip == peer_ip && sender_port == peer_port) {
+            if (sender == peer) {
                 auto [cmd, data] = Protocol::parse(response);
+                if (cmd == Command::RELAY_BIND) {
+                    continue;  // a late answer from the relay itself, not the peer
+                }
+                if (cmd == Command::HOLE_PUNCH) {
+                    setPeerCapabilities(data);
+                }
                 Logger::info("Received message from peer: " + response);
                 Logger::info("P2P connection established!");
                 return true;
             }
-        } catch (const std::runtime_error& e) {
+        } catch (const std::exception& e) {
             std::string error_msg = e.what();
             if (error_msg.find("Failed to receive") != std::string::npos ||
                 error_msg.find("Resource temporarily unavailable") != std::string::npos ||
@@ -198,12 +288,100 @@ bool P2PClient::establishConnection(const std::string& peer_ip, uint16_t peer_po
     return false;
 }
 
-void P2PClient::startP2PCommunication(const std::string& peer_ip, uint16_t peer_port) {
-    Logger::info("Starting P2P communication with " + peer_ip + ":" + std::to_string(peer_port));
+bool P2PClient::connectViaRelay() {
+    if (session_id_.empty()) {
+        Logger::warning("Rendezvous server sent no session id, cannot use the relay");
+        return false;
+    }
 
-    p2p_socket_->setNonBlocking(true);
+    Endpoint relay = Endpoint::parse(options_.relay_address);
+    Logger::info("Direct connection failed, falling back to relay " + options_.relay_address);
+
+    std::string session = "session=" + session_id_;
+    auto allocated = requestRelay(Protocol::serialize(Command::RELAY_ALLOCATE, session), relay,
+                                  Command::RELAY_ALLOCATE, "", std::chrono::seconds(5));
+    if (!allocated) {
+        return false;
+    }
+    std::string port_field = Protocol::parseFields(*allocated)["port"];
+    if (port_field.empty()) {
+        Logger::error("Malformed relay allocation: " + *allocated);
+        return false;
+    }
+    Endpoint session_address(relay.ip(), static_cast<uint16_t>(std::stoi(port_field)));
+
+    // READY arrives once the peer has bound too; punching earlier would be dropped.
+    if (!requestRelay(Protocol::serialize(Command::RELAY_BIND, session), session_address,
+                      Command::RELAY_BIND, "READY", std::chrono::seconds(15))) {
+        return false;
+    }
+
+    peer_ = session_address;
+    Logger::info("Relaying through " + peer_.toString());
+
+    sendHolePunchPackets(peer_, 10, std::chrono::milliseconds(50));
+    return establishConnection(peer_);
+}
+
+std::optional<std::string> P2PClient::requestRelay(const std::string& request, const Endpoint& to,
+                                                   Command reply, const std::string& wanted,
+                                                   std::chrono::seconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto next_send = std::chrono::steady_clock::now();
+    std::string message = request;
+    ReceivedSegments received;
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (std::chrono::steady_clock::now() >= next_send) {
+            p2p_socket_->sendto(message, to);
+            next_send += std::chrono::milliseconds(500);
+        }
+
+        if (!p2p_socket_->tryReceiveSegmentsFrom(received)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        if (received.sender != to) {
+            continue;
+        }
+        for (const auto& response : received.segments) {
+            auto [cmd, data] = Protocol::parse(response);
+            if (cmd == Command::ERROR) {
+                Logger::error("Relay refused: " + data);
+                return std::nullopt;
+            }
+            if (cmd == Command::COOKIE) {
+                // The relay allocates nothing until we echo it, as the rendezvous does.
+                message = request + ";cookie=" + data;
+                next_send = std::chrono::steady_clock::now();
+                Logger::debug("Answered relay cookie");
+                continue;
+            }
+            if (cmd == reply && (wanted.empty() || data == wanted)) {
+                return data;
+            }
+        }
+    }
+
+    Logger::error("Timeout waiting for the relay at " + to.toString());
+    return std::nullopt;
+}
+
+void P2PClient::startP2PCommunication(const Endpoint& peer) {
+    Logger::info("Starting P2P communication with " + peer.toString());
+
+    // The peer is fixed from here on: sends skip the per-datagram route lookup and the
+    // kernel drops datagrams from anyone else.
+    TraceSpan span("start_session", "client");
+    p2p_socket_->connect(peer);
+    enableBusyPoll(*p2p_socket_, options_.io_thread, options_.socket);
+    p2p_io_ = createDatagramIo(options_.io_backend, *p2p_socket_);
+    if (!options_.capture_path.empty()) {
+        p2p_io_ = std::make_unique<CapturingIo>(std::move(p2p_io_), options_.capture_path);
+    }
 
     receiver_thread_ = std::thread(&P2PClient::handleIncomingMessages, this);
+    span.end();
 
     sendMessages();
 
@@ -213,59 +391,167 @@ void P2PClient::startP2PCommunication(const std::string& peer_ip, uint16_t peer_
     }
 }
 
+void P2PClient::replay(std::unique_ptr<DatagramIo> io, const Endpoint& peer) {
+    peer_ = peer;
+    connected_ = true;
+    p2p_io_ = std::move(io);
+    handleIncomingMessages();
+}
+
 void P2PClient::handleIncomingMessages() {
-    while (running_) {
+    Tracer::nameThread("P2P receiver");
+    Tracer::setSession(session_id_);
+
+    auto handler = [this](const ReceivedSegments& received) {
+        IoThreadStats::Processing processing(receiver_stats_);
+        if (received.sender != peer_) {
+            return;
+        }
+        for (const auto& message : received.segments) {
+            TraceSpan span("peer_message", "client");
+            try {
+                handlePeerMessage(message, received.kernel_timestamp);
+            } catch (const std::exception& e) {
+                Logger::error("Error handling message: " + std::string(e.what()));
+            }
+        }
+    };
+
+    while (running_ && !p2p_io_->closed()) {
         try {
-            auto [message, sender_info] = p2p_socket_->receivefrom();
-            auto [sender_ip, sender_port] = sender_info;
-
-            if (sender_ip == peer_ip_ && sender_port == peer_port_) {
-                auto [cmd, data] = Protocol::parse(message);
-
-                switch (cmd) {
-                    case Command::MESSAGE:
-                        Logger::info("Peer says: " + data);
-                        break;
-
-                    case Command::PING:
-                        p2p_socket_->sendto(Protocol::createPong(), peer_ip_, peer_port_);
-                        Logger::debug("Sent PONG to peer");
-                        break;
-
-                    case Command::PONG:
-                        Logger::debug("Received PONG from peer");
-                        break;
-
-                    case Command::QUIT:
-                        Logger::info("Peer disconnected");
-                        running_ = false;
-                        break;
-
-                    default:
-                        Logger::debug("Received from peer: " + message);
-                        break;
-                }
+            // With encryption on, probes are sealed and wait for the session keys.
+            bool probing = options_.mtu_probing && !mtu_prober_.done() &&
+                           (!secure_channel_.isEnabled() || secure_channel_.isEstablished());
+            if (probing) {
+                probePathMtu();
             }
-        } catch (const std::runtime_error& e) {
-            std::string error_msg = e.what();
-            if (error_msg.find("Failed to receive") != std::string::npos ||
-                error_msg.find("Resource temporarily unavailable") != std::string::npos ||
-                error_msg.find("would block") != std::string::npos) {
-                if (running_) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                }
-            } else {
-                Logger::error("Unexpected error in handleIncomingMessages: " + error_msg);
-                if (running_) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                }
+            auto timeout = std::chrono::milliseconds(probing ? 20 : 100);
+            if (options_.io_thread.busy_poll) {
+                timeout = std::chrono::milliseconds(0);
             }
+            receiver_stats_.poll([&] { return p2p_io_->poll(handler, timeout); });
+            reassembly_.expire(std::chrono::steady_clock::now());
         } catch (const std::exception& e) {
             Logger::error("Error receiving message: " + std::string(e.what()));
             if (running_) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
         }
+        receiver_stats_.reportIfDue("P2P receiver");
+    }
+    receiver_stats_.report("P2P receiver");
+}
+
+// HOLE_PUNCH travels in the clear, so with encryption on the capabilities are taken only
+// from the punch that establishes the session; later ones could be spoofed.
+void P2PClient::setPeerCapabilities(const std::string& capabilities) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (secure_channel_.isEnabled()) {
+        if (secure_channel_.isEstablished() || !secure_channel_.setPeerCapabilities(capabilities)) {
+            return;
+        }
+    }
+    compressor_.setPeerCapabilities(capabilities);
+}
+
+void P2PClient::handlePeerMessage(const std::string& message, std::chrono::nanoseconds rx_timestamp,
+                                  bool authenticated) {
+    auto [cmd, data] = Protocol::parse(message);
+
+    // Only the handshake may travel in the clear once encryption is on.
+    if (secure_channel_.isEnabled() && !authenticated && cmd != Command::SEALED &&
+        cmd != Command::HOLE_PUNCH && cmd != Command::RELAY_BIND) {
+        Logger::warning("Dropping unencrypted message from peer");
+        return;
+    }
+
+    switch (cmd) {
+        case Command::MESSAGE:
+            Logger::info("Peer says: " + data);
+            break;
+
+        case Command::PING:
+            sendToPeer(Command::PONG);
+            Logger::debug("Sent PONG to peer");
+            break;
+
+        case Command::PONG: {
+            int64_t sent_ns = ping_sent_ns_.exchange(0);
+            if (sent_ns != 0) {
+                // Kernel receive timestamps and the send mark share CLOCK_REALTIME, so the
+                // RTT excludes time the datagram spent queued behind this thread.
+                auto received_at =
+                    rx_timestamp.count() != 0
+                        ? rx_timestamp
+                        : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::system_clock::now().time_since_epoch());
+                double rtt_us = static_cast<double>(received_at.count() - sent_ns) / 1000.0;
+                Logger::info("Received PONG from peer, RTT: " + std::to_string(rtt_us) + " us");
+            } else {
+                Logger::debug("Received PONG from peer");
+            }
+            break;
+        }
+
+        case Command::QUIT:
+            Logger::info("Peer disconnected");
+            running_ = false;
+            break;
+
+        case Command::FRAGMENT: {
+            auto reassembled = reassembly_.addFragment(data, std::chrono::steady_clock::now());
+            if (reassembled) {
+                Logger::debug("Reassembled " + std::to_string(reassembled->size()) +
+                              " byte message");
+                handlePeerMessage(*reassembled, rx_timestamp, authenticated);
+            }
+            break;
+        }
+
+        case Command::MTU_PROBE: {
+            size_t colon_pos = data.find(':');
+            size_t wire_size = message.size() + (authenticated ? secure_channel_.getOverhead() : 0);
+            if (colon_pos != std::string::npos &&
+                std::stoul(data.substr(0, colon_pos)) == wire_size) {
+                sendToPeer(Command::MTU_ACK, data.substr(0, colon_pos));
+            }
+            break;
+        }
+
+        case Command::HOLE_PUNCH:
+            setPeerCapabilities(data);
+            break;
+
+        case Command::RELAY_BIND:
+            break;  // retransmitted bind answers from the relay
+
+        case Command::COMPRESSED: {
+            auto decompressed = compressor_.decompress(data);
+            if (decompressed) {
+                handlePeerMessage(*decompressed, rx_timestamp, authenticated);
+            }
+            break;
+        }
+
+        case Command::SEALED:
+            if (secure_channel_.open(data)) {
+                handlePeerMessage(data, rx_timestamp, true);
+            } else {
+                Logger::debug("Dropping unauthenticated packet from peer");
+            }
+            break;
+
+        case Command::MTU_ACK: {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            mtu_prober_.onAck(std::stoul(data));
+            fragmenter_.setMaxDatagramSize(mtu_prober_.getDatagramSize() -
+                                           secure_channel_.getOverhead());
+            break;
+        }
+
+        default:
+            Logger::debug("Received from peer: " + message);
+            break;
     }
 }
 
@@ -279,28 +565,101 @@ void P2PClient::sendMessages() {
         }
 
         if (input == "QUIT") {
-            p2p_socket_->sendto(Protocol::serialize(Command::QUIT), peer_ip_, peer_port_);
+            try {
+                sendToPeer(Command::QUIT);
+            } catch (const std::exception& e) {
+                Logger::error("Failed to send QUIT: " + std::string(e.what()));
+            }
             running_ = false;
             break;
         }
 
-        std::string command;
-        if (input.find(':') == std::string::npos && input != "PING") {
-            command = Protocol::serialize(Command::MESSAGE, input);
-        } else {
-            command = input;
+        try {
+            if (input == "PING") {
+                ping_sent_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::system_clock::now().time_since_epoch())
+                                    .count();
+                sendToPeer(Command::PING);
+            } else if (input.find(':') == std::string::npos) {
+                sendToPeer(Command::MESSAGE, input);
+            } else {
+                sendToPeer(input);
+            }
+            Logger::debug("Sent to peer: " + input);
+        } catch (const std::exception& e) {
+            Logger::error("Failed to send message: " + std::string(e.what()));
         }
+    }
+}
 
-        if (input == "PING") {
-            command = Protocol::serialize(Command::PING);
+// A message that goes out as one datagram uncompressed is never serialized into one
+// string: seal() or, without encryption, the socket gathers the header and the data.
+void P2PClient::sendToPeer(Command command, const std::string& data) {
+    std::string header = Protocol::header(command, !data.empty());
+    size_t size = header.size() + data.size();
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (!compressor_.compresses(size) && size <= fragmenter_.getMaxDatagramSize()) {
+            if (secure_channel_.isEnabled()) {
+                p2p_io_->sendto(secure_channel_.seal({header, data}), peer_);
+            } else {
+                p2p_io_->sendv({header, data}, peer_);
+            }
+            p2p_io_->flush();
+            return;
         }
+    }
+    sendToPeer(header + data);
+}
 
-        try {
-            p2p_socket_->sendto(command, peer_ip_, peer_port_);
-            Logger::debug("Sent to peer: " + command);
-        } catch (const std::exception& e) {
-            Logger::error("Failed to send message: " + std::string(e.what()));
+void P2PClient::sendToPeer(const std::string& plain_message) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+
+    std::string message = compressor_.compress(plain_message);
+
+    if (fragmenter_.needsFragmentation(message)) {
+        auto fragments = fragmenter_.fragment(message);
+        Logger::debug("Sending " + std::to_string(message.size()) + " byte message in " +
+                      std::to_string(fragments.size()) + " fragments");
+        // Sealed per fragment: every datagram is authenticated before it reaches reassembly.
+        for (auto& fragment : fragments) {
+            fragment = sealForPeer(fragment);
         }
+        p2p_io_->sendBatch(fragments, peer_);
+    } else {
+        p2p_io_->sendto(sealForPeer(message), peer_);
+    }
+    p2p_io_->flush();
+}
+
+// Callers hold send_mutex_, which serializes the packet counter.
+std::string P2PClient::sealForPeer(const std::string& message) {
+    if (!secure_channel_.isEnabled()) {
+        return message;
+    }
+    return secure_channel_.seal(message);
+}
+
+void P2PClient::probePathMtu() {
+    size_t probe_size = mtu_prober_.nextProbe(std::chrono::steady_clock::now());
+    if (probe_size == 0) {
+        return;
+    }
+
+    std::string probe;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        probe = sealForPeer(PathMtuProber::createProbe(probe_size, secure_channel_.getOverhead()));
+    }
+
+    try {
+        // Sent straight through the socket so a local EMSGSIZE surfaces synchronously.
+        p2p_socket_->sendto(probe, peer_);
+    } catch (const std::exception& e) {
+        Logger::debug("MTU probe of " + std::to_string(probe_size) + " bytes rejected: " +
+                      e.what());
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        mtu_prober_.onProbeFailed(probe_size);
     }
 }
 
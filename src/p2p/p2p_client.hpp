@@ -1,8 +1,17 @@
 #pragma once
 
 #include "../common/socket_wrapper.hpp"
+#include "../common/datagram_io.hpp"
+#include "../common/io_thread.hpp"
+#include "../common/compression.hpp"
+#include "../common/fragmentation.hpp"
+#include "../common/path_mtu.hpp"
 #include "../common/protocol.hpp"
+#include "../common/secure_channel.hpp"
 #include "../common/logger.hpp"
+#include <chrono>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <atomic>
@@ -10,31 +19,69 @@
 
 namespace network {
 
+struct P2PClientOptions {
+    SocketOptions socket;
+    IoBackend io_backend = IoBackend::EPOLL;
+    bool mtu_probing = true;
+    size_t max_datagram_size = PathMtuProber::ETHERNET_DATAGRAM_SIZE;  // PMTU search ceiling
+    bool compression = true;
+    std::string dictionary_path;  // shared LZ4 dictionary, see train-dict mode
+    bool encryption = true;
+    std::string room;  // rendezvous room, see Protocol::createRegister
+    std::string relay_address;  // "ip:port" ("[ip]:port") of a relay to fall back to, empty disables
+    std::string capture_path;   // record datagrams received from the peer, see CaptureWriter
+    IoThreadOptions io_thread;  // placement of the client's threads, busy polling of the receiver
+};
+
 class P2PClient {
    public:
-    P2PClient(const std::string& rendezvous_address, uint16_t rendezvous_port);
+    P2PClient(const std::string& rendezvous_address, uint16_t rendezvous_port,
+              const P2PClientOptions& options = {});
     void run();
+    // Runs the receive loop over `io` (e.g. a ReplayIo) as if connected to the given
+    // peer, until the peer quits or `io` closes.
+    void replay(std::unique_ptr<DatagramIo> io, const Endpoint& peer);
 
    private:
     void connectToRendezvous();
     void registerWithRendezvous();
     void waitForPeerInfo();
-    void performHolePunching(const std::string& peer_ip, uint16_t peer_port);
-    void startP2PCommunication(const std::string& peer_ip, uint16_t peer_port);
+    void performHolePunching(const Endpoint& peer);
+    void startP2PCommunication(const Endpoint& peer);
     void handleIncomingMessages();
+    void handlePeerMessage(const std::string& message, std::chrono::nanoseconds rx_timestamp,
+                           bool authenticated = false);
+    void setPeerCapabilities(const std::string& capabilities);
     void sendMessages();
-    bool establishConnection(const std::string& peer_ip, uint16_t peer_port);
-    void sendHolePunchPackets(const std::string& peer_ip, uint16_t peer_port, int count);
+    void sendToPeer(Command command, const std::string& data = "");
+    void sendToPeer(const std::string& plain_message);
+    std::string sealForPeer(const std::string& message);
+    void probePathMtu();
+    bool establishConnection(const Endpoint& peer);
+    bool connectViaRelay();
+    std::optional<std::string> requestRelay(const std::string& request, const Endpoint& to,
+                                            Command reply, const std::string& wanted,
+                                            std::chrono::seconds timeout);
+    void sendHolePunchPackets(const Endpoint& peer, int count, std::chrono::milliseconds interval);
 
-    std::string rendezvous_address_;
-    uint16_t rendezvous_port_;
+    Endpoint rendezvous_;
+    P2PClientOptions options_;
     std::unique_ptr<SocketWrapper> rendezvous_socket_;
     std::unique_ptr<SocketWrapper> p2p_socket_;
-    std::string peer_ip_;
-    uint16_t peer_port_;
+    std::unique_ptr<DatagramIo> p2p_io_;
+    IoThreadStats receiver_stats_;
+    Endpoint peer_;
+    std::string session_id_;  // from PEER_INFO, names our pair at the relay
     std::atomic<bool> connected_;
     std::atomic<bool> running_;
     std::thread receiver_thread_;
+    std::atomic<int64_t> ping_sent_ns_;
+    std::mutex send_mutex_;
+    MessageFragmenter fragmenter_;
+    ReassemblyBuffer reassembly_;
+    PathMtuProber mtu_prober_;
+    MessageCompressor compressor_;
+    SecureChannel secure_channel_;
 };
 
 }  // namespace network
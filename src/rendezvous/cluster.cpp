@@ -0,0 +1,176 @@
+#include "cluster.hpp"
+#include "../common/protocol.hpp"
+#include "../common/siphash.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace network {
+
+Cluster::Cluster(const std::vector<std::string>& members, const std::string& self,
+                 const SipHash::Key& key)
+    : key_(key), self_index_(members.size()) {
+    // Nodes start out alive for one failure timeout so that routing does not wait for
+    // the first round of heartbeats.
+    auto now = std::chrono::steady_clock::now();
+    Endpoint self_address = Protocol::parsePeerInfo(self);
+    for (const auto& member : members) {
+        Endpoint address = Protocol::parsePeerInfo(member);
+        if (address == self_address) {
+            self_index_ = nodes_.size();
+        }
+        nodes_.push_back(ClusterNode{address, true, now});
+    }
+
+    if (self_index_ == members.size()) {
+        throw std::runtime_error("Node address " + self + " is not in the cluster member list");
+    }
+
+    rebuildRing();
+    Logger::info("Cluster of " + std::to_string(nodes_.size()) + " nodes, this node is " + self);
+}
+
+SipHash::Key Cluster::parseKey(const std::string& hex) {
+    SipHash::Key key;
+    bool valid = hex.size() == key.size() * 2;
+    for (size_t i = 0; valid && i < key.size(); ++i) {
+        char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        char* end = nullptr;
+        key[i] = static_cast<uint8_t>(std::strtoul(byte, &end, 16));
+        valid = std::isxdigit(static_cast<unsigned char>(byte[0])) && *end == '\0';
+    }
+    if (!valid) {
+        throw std::runtime_error("Cluster key must be " + std::to_string(key.size() * 2) +
+                                 " hex characters");
+    }
+    return key;
+}
+
+bool Cluster::isMember(const Endpoint& address) const {
+    for (const auto& node : nodes_) {
+        if (node.address == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const ClusterNode* Cluster::ownerOf(const std::string& room) const {
+    uint64_t point = hash(room);
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(point, size_t{0}));
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return it->second == self_index_ ? nullptr : &nodes_[it->second];
+}
+
+void Cluster::onHeartbeat(const Endpoint& address, std::chrono::steady_clock::time_point now) {
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        auto& node = nodes_[i];
+        if (i == self_index_ || node.address != address) {
+            continue;
+        }
+        node.last_heard = now;
+        if (!node.alive) {
+            node.alive = true;
+            Logger::info("Cluster node " + address.toString() + " is up");
+            rebuildRing();
+        }
+        return;
+    }
+}
+
+std::string Cluster::sign(Command command, const std::string& data) const {
+    auto time = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    std::string body = (data.empty() ? "" : data + ";") + "t=" + std::to_string(time.count());
+    return Protocol::serialize(command, body + ";mac=" + mac(command, body));
+}
+
+bool Cluster::verify(Command command, const std::string& data) const {
+    size_t mac_pos = data.rfind(";mac=");
+    if (mac_pos == std::string::npos || data.size() - mac_pos - 5 != MAC_SIZE) {
+        return false;
+    }
+    std::string body = data.substr(0, mac_pos);
+    std::string expected = mac(command, body);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < MAC_SIZE; ++i) {
+        diff |= static_cast<uint8_t>(expected[i] ^ data[mac_pos + 5 + i]);
+    }
+    if (diff != 0) {
+        return false;
+    }
+
+    // Covered by the MAC, so well-formed unless the key leaked.
+    size_t time_pos = body.rfind(';') + 1;  // 0 for a heartbeat, which has no other fields
+    if (body.compare(time_pos, 2, "t=") != 0) {
+        return false;
+    }
+    long long signed_at = std::strtoll(body.c_str() + time_pos + 2, nullptr, 10);
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    return std::llabs(now.count() - signed_at) <= MAX_CLOCK_SKEW.count();
+}
+
+std::string Cluster::mac(Command command, const std::string& body) const {
+    std::string input = Protocol::serialize(command, body);
+    char hex[MAC_SIZE + 1];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+                  static_cast<unsigned long long>(SipHash::hash(key_, input.data(), input.size())));
+    return std::string(hex, MAC_SIZE);
+}
+
+void Cluster::tick(DatagramIo& io, std::chrono::steady_clock::time_point now) {
+    if (now - last_heartbeat_sent_ >= HEARTBEAT_INTERVAL) {
+        std::string heartbeat = sign(Command::CLUSTER_HEARTBEAT, "");
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            if (i == self_index_) {
+                continue;
+            }
+            try {
+                io.sendto(heartbeat, nodes_[i].address);
+            } catch (const std::exception& e) {
+                Logger::debug("Failed to send heartbeat: " + std::string(e.what()));
+            }
+        }
+        last_heartbeat_sent_ = now;
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        auto& node = nodes_[i];
+        if (i != self_index_ && node.alive && now - node.last_heard > FAILURE_TIMEOUT) {
+            node.alive = false;
+            changed = true;
+            Logger::warning("Cluster node " + node.address.toString() + " is down");
+        }
+    }
+    if (changed) {
+        rebuildRing();
+    }
+}
+
+void Cluster::rebuildRing() {
+    ring_.clear();
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (i != self_index_ && !nodes_[i].alive) {
+            continue;
+        }
+        std::string name = nodes_[i].address.toString() + "#";
+        for (size_t v = 0; v < VIRTUAL_NODES; ++v) {
+            ring_.emplace_back(hash(name + std::to_string(v)), i);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+// Every node must place rooms identically, so the ring uses a fixed, public key.
+uint64_t Cluster::hash(const std::string& key) {
+    static const SipHash::Key ring_key{};
+    return SipHash::hash(ring_key, key.data(), key.size());
+}
+
+}  // namespace network
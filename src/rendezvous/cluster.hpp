@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../common/datagram_io.hpp"
+#include "../common/logger.hpp"
+#include "../common/protocol.hpp"
+#include "../common/siphash.hpp"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace network {
+
+struct ClusterNode {
+    Endpoint address;
+    bool alive;
+    std::chrono::steady_clock::time_point last_heard;
+};
+
+// Static rendezvous cluster membership with heartbeat failure detection. Every room is
+// owned by one node, chosen by consistent hashing over the nodes currently alive, and
+// all registrations for a room are forwarded to its owner, so two peers pair no matter
+// which node each of them contacted. When a node stops answering, only the rooms it
+// owned move.
+//
+// Nodes share a secret key, and every cluster message carries a MAC under it:
+//     <command>:<data>;t=<unix time>;mac=<SipHash-2-4, 16 hex>
+// so a packet spoofed from a node's address can neither register peers nor make a node
+// send PEER_INFO to an address of its choosing. A captured message is accepted again
+// only within MAX_CLOCK_SKEW of when it was signed, which needs the nodes' clocks to
+// agree that closely.
+class Cluster {
+   public:
+    static constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{500};
+    static constexpr std::chrono::milliseconds FAILURE_TIMEOUT{2000};
+    static constexpr size_t VIRTUAL_NODES = 64;
+    static constexpr std::chrono::seconds MAX_CLOCK_SKEW{30};
+    static constexpr size_t MAC_SIZE = 16;  // hex characters
+
+    // `members` lists every node as "ip:port" ("[ip]:port" for IPv6), `self` is this
+    // node's entry, `key` the secret shared by all of them.
+    Cluster(const std::vector<std::string>& members, const std::string& self,
+            const SipHash::Key& key);
+
+    // Parses a cluster key given as 32 hex characters.
+    static SipHash::Key parseKey(const std::string& hex);
+
+    bool isMember(const Endpoint& address) const;
+
+    // The complete datagram for a cluster message, timestamped and MACed.
+    std::string sign(Command command, const std::string& data) const;
+
+    // Whether the data part of a received cluster message carries a valid, recent MAC.
+    bool verify(Command command, const std::string& data) const;
+
+    // The node that owns `room`, or nullptr when it is this node.
+    const ClusterNode* ownerOf(const std::string& room) const;
+
+    void onHeartbeat(const Endpoint& address, std::chrono::steady_clock::time_point now);
+
+    // Sends heartbeats when due and marks silent nodes down.
+    void tick(DatagramIo& io, std::chrono::steady_clock::time_point now);
+
+    size_t size() const { return nodes_.size(); }
+
+   private:
+    void rebuildRing();
+    static uint64_t hash(const std::string& key);
+    std::string mac(Command command, const std::string& body) const;
+
+    SipHash::Key key_;
+    std::vector<ClusterNode> nodes_;
+    size_t self_index_;
+    std::vector<std::pair<uint64_t, size_t>> ring_;
+    std::chrono::steady_clock::time_point last_heartbeat_sent_;
+};
+
+}  // namespace network
@@ -0,0 +1,223 @@
+#include "cluster_harness.hpp"
+#include "rendezvous_server.hpp"
+#include <poll.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+namespace network {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct SimulatedClient {
+    std::unique_ptr<SocketWrapper> socket;
+    uint16_t local_port = 0;
+    Endpoint node;  // the rendezvous node it registers with
+    std::string cookie;
+    bool registered = false;
+    bool matched = false;
+    uint16_t matched_port = 0;
+    Clock::time_point matched_at;
+};
+
+void handleResponse(SimulatedClient& client, const std::string& message) {
+    auto [cmd, data] = Protocol::parse(message);
+    if (cmd == Command::COOKIE) {
+        client.cookie = data;
+    } else if (cmd == Command::REGISTER) {
+        client.registered = true;
+    } else if (cmd == Command::PEER_INFO) {
+        client.matched = true;
+        client.matched_port = Protocol::parsePeerInfo(data).port();
+        client.matched_at = Clock::now();
+    } else if (cmd == Command::ERROR) {
+        std::cerr << "Node error: " << data << "\n";
+    }
+}
+
+// Dispatches responses on the given clients until `done` holds or `timeout` passes.
+bool pump(std::vector<SimulatedClient*> clients, const std::function<bool()>& done,
+          Clock::duration timeout) {
+    std::vector<pollfd> fds;
+    for (auto* client : clients) {
+        fds.push_back(pollfd{client->socket->getFd(), POLLIN, 0});
+    }
+
+    ReceivedSegments received;
+    auto deadline = Clock::now() + timeout;
+    while (!done()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        if (::poll(fds.data(), fds.size(), 10) <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            while (clients[i]->socket->tryReceiveSegmentsFrom(received)) {
+                for (const auto& segment : received.segments) {
+                    handleResponse(*clients[i], segment);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void sendRegister(SimulatedClient& client, const std::string& room) {
+    client.registered = false;
+    client.matched = false;
+    client.socket->sendto(Protocol::createRegister(client.cookie, "", room), client.node);
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+}  // namespace
+
+void runClusterHarness(const ClusterHarnessOptions& options) {
+    if (options.nodes == 0 || options.pairs == 0) {
+        throw std::runtime_error("Cluster harness needs at least one node and one pair");
+    }
+
+    Logger::setLevel(Logger::Level::WARNING);
+
+    SipHash::Key cluster_key = SipHash::randomKey();
+    std::vector<std::string> members;
+    for (size_t i = 0; i < options.nodes; ++i) {
+        members.push_back("127.0.0.1:" + std::to_string(options.base_port + i));
+    }
+
+    std::vector<std::unique_ptr<RendezvousServer>> nodes;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < options.nodes; ++i) {
+        RendezvousServerOptions node_options;
+        node_options.io_backend = options.io_backend;
+        node_options.rate_limit = 0;  // every simulated client shares 127.0.0.1
+        node_options.max_peers = options.pairs * 2;
+        node_options.max_peers_per_ip = 0;
+        node_options.cluster_members = members;
+        node_options.cluster_key = cluster_key;
+        auto port = static_cast<uint16_t>(options.base_port + i);
+        nodes.push_back(std::make_unique<RendezvousServer>("127.0.0.1", port, node_options));
+        threads.emplace_back([node = nodes.back().get()] { node->run(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // The two peers of pair k register with nodes k and k + 1.
+    std::vector<SimulatedClient> clients(options.pairs * 2);
+    std::vector<SimulatedClient*> all;
+    for (size_t i = 0; i < clients.size(); ++i) {
+        auto& client = clients[i];
+        client.socket = std::make_unique<SocketWrapper>(SocketWrapper::Type::UDP);
+        client.socket->bind(0);
+        client.socket->setNonBlocking(true);
+        client.local_port = client.socket->getLocalAddress().port();
+        size_t node = (i / 2 + i % 2) % options.nodes;
+        client.node = Endpoint("127.0.0.1", static_cast<uint16_t>(options.base_port + node));
+        all.push_back(&client);
+    }
+
+    auto wait_all = [&](auto predicate) {
+        return pump(all, [&] { return std::all_of(all.begin(), all.end(), predicate); },
+                    std::chrono::seconds(10));
+    };
+
+    for (auto& client : clients) {
+        client.socket->sendto(Protocol::createCookieRequest(), client.node);
+    }
+    if (!wait_all([](SimulatedClient* c) { return !c->cookie.empty(); })) {
+        throw std::runtime_error("Timeout waiting for registration cookies");
+    }
+
+    size_t mismatched = 0;
+    auto check_pair = [&](const SimulatedClient& a, const SimulatedClient& b) {
+        if (a.matched_port != b.local_port || b.matched_port != a.local_port) {
+            ++mismatched;
+        }
+    };
+
+    // Latency: one pair at a time, from the second registration to both PEER_INFOs.
+    std::vector<double> latencies_us;
+    for (size_t k = 0; k < options.pairs; ++k) {
+        auto& a = clients[2 * k];
+        auto& b = clients[2 * k + 1];
+        std::string room = "latency-" + std::to_string(k);
+
+        sendRegister(a, room);
+        if (!pump({&a}, [&] { return a.registered; }, std::chrono::seconds(5))) {
+            throw std::runtime_error("Timeout registering client " + std::to_string(2 * k));
+        }
+
+        auto start = Clock::now();
+        sendRegister(b, room);
+        if (!pump({&a, &b}, [&] { return a.matched && b.matched; }, std::chrono::seconds(5))) {
+            throw std::runtime_error("Timeout pairing " + room);
+        }
+        auto finished = std::max(a.matched_at, b.matched_at);
+        latencies_us.push_back(
+            std::chrono::duration<double, std::micro>(finished - start).count());
+        check_pair(a, b);
+    }
+
+    // Throughput: every first peer waits in its room, then all second peers arrive at once.
+    for (size_t k = 0; k < options.pairs; ++k) {
+        sendRegister(clients[2 * k], "bulk-" + std::to_string(k));
+    }
+    std::vector<SimulatedClient*> waiting;
+    for (size_t k = 0; k < options.pairs; ++k) {
+        waiting.push_back(&clients[2 * k]);
+    }
+    if (!pump(waiting,
+              [&] {
+                  return std::all_of(waiting.begin(), waiting.end(),
+                                     [](SimulatedClient* c) { return c->registered; });
+              },
+              std::chrono::seconds(10))) {
+        throw std::runtime_error("Timeout registering waiting peers");
+    }
+
+    auto start = Clock::now();
+    for (size_t k = 0; k < options.pairs; ++k) {
+        sendRegister(clients[2 * k + 1], "bulk-" + std::to_string(k));
+    }
+    if (!wait_all([](SimulatedClient* c) { return c->matched; })) {
+        throw std::runtime_error("Timeout waiting for bulk pairing");
+    }
+    auto elapsed = Clock::now() - start;
+    for (size_t k = 0; k < options.pairs; ++k) {
+        check_pair(clients[2 * k], clients[2 * k + 1]);
+    }
+
+    for (auto& node : nodes) {
+        node->stop();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << "Cluster harness: " << options.nodes << " nodes, " << options.pairs
+              << " pairs, peers of each pair on different nodes\n";
+    std::cout << "Pairing latency (us): p50 " << percentile(latencies_us, 0.5) << ", p99 "
+              << percentile(latencies_us, 0.99) << ", max " << percentile(latencies_us, 1.0)
+              << "\n";
+    std::cout << "Pairing throughput: " << static_cast<double>(options.pairs) / seconds
+              << " pairs/s (" << options.pairs << " pairs in " << seconds * 1000 << " ms)\n";
+    if (mismatched != 0) {
+        std::cout << "Mismatched pairs: " << mismatched << "\n";
+    }
+}
+
+}  // namespace network
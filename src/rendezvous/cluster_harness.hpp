@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../common/datagram_io.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace network {
+
+struct ClusterHarnessOptions {
+    size_t nodes = 3;
+    size_t pairs = 200;
+    uint16_t base_port = 9400;  // nodes listen on consecutive ports from here
+    IoBackend io_backend = IoBackend::EPOLL;
+};
+
+// Starts a rendezvous cluster on localhost and pairs simulated clients across it: the
+// two peers of every pair register with different nodes. Reports the pairing latency
+// of pairs registered one at a time and the throughput of all pairs registered at once.
+void runClusterHarness(const ClusterHarnessOptions& options);
+
+}  // namespace network
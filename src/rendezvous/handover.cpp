@@ -0,0 +1,179 @@
+#include "handover.hpp"
+#include "../common/logger.hpp"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace network {
+
+namespace {
+
+constexpr char READY[] = "READY";
+constexpr size_t MAX_PATH_MESSAGE = 4096;
+
+struct sockaddr_un makeAddress(const std::string& path) {
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid handover socket path: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+bool waitReadable(int fd, std::chrono::milliseconds timeout) {
+    struct pollfd pfd{fd, POLLIN, 0};
+    int ready;
+    do {
+        ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0;
+}
+
+}  // namespace
+
+HandoverListener::HandoverListener(const std::string& path)
+    : path_(path), fd_(-1), handed_over_(false) {
+    auto addr = makeAddress(path);
+    fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to create handover socket");
+    }
+
+    ::unlink(path.c_str());
+    if (::bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd_, 1) < 0) {
+        int error = errno;
+        ::close(fd_);
+        throw std::runtime_error("Failed to listen for handover on " + path + ": " + std::strerror(error));
+    }
+    Logger::info("Accepting handover requests on " + path);
+}
+
+HandoverListener::~HandoverListener() {
+    ::close(fd_);
+    if (!handed_over_) {
+        ::unlink(path_.c_str());
+    }
+}
+
+int HandoverListener::accept() {
+    int connection = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        Logger::warning("Failed to accept handover request: " + std::string(std::strerror(errno)));
+    }
+    return connection;
+}
+
+bool HandoverListener::handOver(int connection, int socket_fd, const std::string& snapshot_path,
+                                std::chrono::milliseconds timeout) {
+    struct iovec iov{const_cast<char*>(snapshot_path.data()), snapshot_path.size()};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &socket_fd, sizeof(int));
+
+    bool confirmed = false;
+    if (::sendmsg(connection, &msg, MSG_NOSIGNAL) < 0) {
+        Logger::warning("Failed to pass socket to successor: " + std::string(std::strerror(errno)));
+    } else if (waitReadable(connection, timeout)) {
+        char reply[sizeof(READY)] = {};
+        ssize_t size = ::recv(connection, reply, sizeof(reply), 0);
+        confirmed = size == static_cast<ssize_t>(sizeof(READY) - 1) &&
+                    std::memcmp(reply, READY, sizeof(READY) - 1) == 0;
+    }
+    ::close(connection);
+
+    handed_over_ = confirmed;
+    return confirmed;
+}
+
+std::unique_ptr<Takeover> Takeover::request(const std::string& path, std::chrono::milliseconds timeout) {
+    auto addr = makeAddress(path);
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (connection < 0) {
+        throw std::runtime_error("Failed to create handover socket");
+    }
+
+    if (::connect(connection, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        int error = errno;
+        ::close(connection);
+        if (error == ENOENT || error == ECONNREFUSED) {
+            Logger::info("No running server at " + path + " to take over from");
+            return nullptr;
+        }
+        throw std::runtime_error("Failed to connect to handover socket " + path + ": " +
+                                 std::strerror(error));
+    }
+    Logger::info("Requested handover from the server at " + path);
+
+    // The predecessor answers once its current poll returns and the snapshot is written.
+    char path_buffer[MAX_PATH_MESSAGE];
+    struct iovec iov{path_buffer, sizeof(path_buffer)};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t size = -1;
+    if (waitReadable(connection, timeout)) {
+        size = ::recvmsg(connection, &msg, MSG_CMSG_CLOEXEC);
+    }
+
+    int socket_fd = -1;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); size > 0 && cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&socket_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (socket_fd < 0) {
+        ::close(connection);
+        throw std::runtime_error("Server at " + path + " did not hand over its socket");
+    }
+
+    return std::unique_ptr<Takeover>(
+        new Takeover(connection, socket_fd, std::string(path_buffer, static_cast<size_t>(size))));
+}
+
+Takeover::Takeover(int connection, int socket_fd, std::string snapshot_path)
+    : connection_(connection), socket_fd_(socket_fd), snapshot_path_(std::move(snapshot_path)) {}
+
+Takeover::~Takeover() {
+    if (socket_fd_ >= 0) {
+        ::close(socket_fd_);
+    }
+    if (connection_ >= 0) {
+        ::close(connection_);
+    }
+}
+
+int Takeover::releaseSocket() {
+    int fd = socket_fd_;
+    socket_fd_ = -1;
+    return fd;
+}
+
+void Takeover::confirm() {
+    if (::send(connection_, READY, sizeof(READY) - 1, MSG_NOSIGNAL) < 0) {
+        Logger::warning("Failed to confirm handover: " + std::string(std::strerror(errno)));
+    }
+    ::close(connection_);
+    connection_ = -1;
+}
+
+}  // namespace network
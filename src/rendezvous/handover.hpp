@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace network {
+
+// Zero-downtime restart of a UDP server. The running process listens on a Unix socket;
+// a new process connects to it, the old one stops reading, snapshots its state and
+// passes its bound UDP socket across with SCM_RIGHTS. Both processes then hold the same
+// kernel socket, so datagrams arriving during the switch wait in its receive buffer for
+// the new process instead of being dropped or answered with ICMP port unreachable.
+//
+//   new                          old
+//   connect(path)  ------------> accept, stop reading, write snapshot
+//                  <------------ snapshot path + UDP socket (SCM_RIGHTS)
+//   load snapshot, start reading
+//   "READY"        ------------> exit
+//
+// If the new process disconnects before READY the old one resumes serving.
+
+// Predecessor side: the running server's listening socket.
+class HandoverListener {
+   public:
+    // Binds `path`, replacing a stale socket or the one a predecessor listened on.
+    explicit HandoverListener(const std::string& path);
+    ~HandoverListener();
+
+    HandoverListener(const HandoverListener&) = delete;
+    HandoverListener& operator=(const HandoverListener&) = delete;
+
+    // Accepts a waiting successor without blocking. Returns its connection, -1 if none.
+    int accept();
+
+    // Passes `socket_fd` and the snapshot path over `connection` and waits up to `timeout`
+    // for the successor to confirm. Closes `connection`. Returns false if the successor
+    // failed, in which case the caller still owns the socket and should keep serving.
+    bool handOver(int connection, int socket_fd, const std::string& snapshot_path,
+                  std::chrono::milliseconds timeout);
+
+   private:
+    std::string path_;
+    int fd_;
+    bool handed_over_;  // the path now belongs to the successor's listener
+};
+
+// Successor side: the socket and state received from a running server.
+class Takeover {
+   public:
+    // Asks the server listening at `path` for its socket. Returns nullptr when nothing
+    // listens there, i.e. on a cold start.
+    static std::unique_ptr<Takeover> request(const std::string& path,
+                                             std::chrono::milliseconds timeout);
+    // Closes the connection; unless confirm() was called the predecessor resumes.
+    ~Takeover();
+
+    Takeover(const Takeover&) = delete;
+    Takeover& operator=(const Takeover&) = delete;
+
+    // Hands ownership of the inherited UDP socket to the caller.
+    int releaseSocket();
+    const std::string& snapshotPath() const { return snapshot_path_; }
+
+    // Tells the predecessor the state is loaded and it may exit.
+    void confirm();
+
+   private:
+    Takeover(int connection, int socket_fd, std::string snapshot_path);
+
+    int connection_;
+    int socket_fd_;
+    std::string snapshot_path_;
+};
+
+}  // namespace network
@@ -0,0 +1,192 @@
+#include "peer_snapshot.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace network {
+
+namespace {
+
+// Read-only mapping of a whole file, unmapped on scope exit.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open peer snapshot " + path + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(PeerSnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Not a peer snapshot: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Failed to map peer snapshot " + path);
+        }
+        data_ = static_cast<const char*>(map);
+    }
+
+    ~MappedFile() { munmap(const_cast<char*>(data_), size_); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+   private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace
+
+void savePeerSnapshot(const std::string& path, const std::map<std::string, PeerInfo>& peers,
+                      const std::map<std::string, std::string>& waiting, const AddressCookie& cookie) {
+    size_t pool_size = 0;
+    for (const auto& [id, peer] : peers) {
+        pool_size += id.size() + peer.room.size();
+    }
+    for (const auto& [room, id] : waiting) {
+        pool_size += room.size() + id.size();
+    }
+    if (pool_size > std::numeric_limits<uint32_t>::max() ||
+        peers.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Peer table too large for a snapshot");
+    }
+
+    size_t records_offset = sizeof(PeerSnapshotHeader);
+    size_t waiting_offset = records_offset + peers.size() * sizeof(PeerSnapshotRecord);
+    size_t pool_offset = waiting_offset + waiting.size() * sizeof(WaitingSnapshotRecord);
+    size_t file_size = pool_offset + pool_size;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create peer snapshot " + path + ": " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(file_size)) < 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to size peer snapshot: " + std::string(std::strerror(errno)));
+    }
+    void* map = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Failed to map peer snapshot: " + std::string(std::strerror(errno)));
+    }
+    char* data = static_cast<char*>(map);
+
+    PeerSnapshotHeader header{};
+    std::memcpy(header.magic, PEER_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = PEER_SNAPSHOT_VERSION;
+    header.peers = static_cast<uint32_t>(peers.size());
+    header.waiting = static_cast<uint32_t>(waiting.size());
+    std::memcpy(header.cookie_key, cookie.getKey().data(), sizeof(header.cookie_key));
+    header.cookie_epoch_ns = cookie.getStart().time_since_epoch().count();
+    std::memcpy(data, &header, sizeof(header));
+
+    size_t pool = 0;
+    auto append = [&](const std::string& text) {
+        std::memcpy(data + pool_offset + pool, text.data(), text.size());
+        pool += text.size();
+    };
+
+    auto* records = reinterpret_cast<PeerSnapshotRecord*>(data + records_offset);
+    for (const auto& [id, peer] : peers) {
+        PeerSnapshotRecord record{};
+        record.registered_ns = peer.registered_at.time_since_epoch().count();
+        std::memcpy(record.address, peer.address.mapped().addressBytes(), sizeof(record.address));
+        record.port = peer.address.port();
+        if (!peer.ingress.empty()) {
+            std::memcpy(record.ingress, peer.ingress.mapped().addressBytes(), sizeof(record.ingress));
+            record.ingress_port = peer.ingress.port();
+        }
+        record.id_length = static_cast<uint16_t>(id.size());
+        record.room_length = static_cast<uint16_t>(peer.room.size());
+        record.strings = static_cast<uint32_t>(pool);
+        *records++ = record;
+        append(id);
+        append(peer.room);
+    }
+
+    auto* entries = reinterpret_cast<WaitingSnapshotRecord*>(data + waiting_offset);
+    for (const auto& [room, id] : waiting) {
+        WaitingSnapshotRecord entry{};
+        entry.strings = static_cast<uint32_t>(pool);
+        entry.room_length = static_cast<uint16_t>(room.size());
+        entry.id_length = static_cast<uint16_t>(id.size());
+        *entries++ = entry;
+        append(room);
+        append(id);
+    }
+
+    munmap(map, file_size);
+}
+
+void loadPeerSnapshot(const std::string& path, std::map<std::string, PeerInfo>& peers,
+                      std::map<std::string, std::string>& waiting, AddressCookie& cookie) {
+    MappedFile file(path);
+
+    PeerSnapshotHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, PEER_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PEER_SNAPSHOT_VERSION) {
+        throw std::runtime_error("Not a peer snapshot: " + path);
+    }
+
+    size_t records_offset = sizeof(PeerSnapshotHeader);
+    size_t waiting_offset = records_offset + size_t{header.peers} * sizeof(PeerSnapshotRecord);
+    size_t pool_offset = waiting_offset + size_t{header.waiting} * sizeof(WaitingSnapshotRecord);
+    if (pool_offset > file.size()) {
+        throw std::runtime_error("Peer snapshot is truncated: " + path);
+    }
+    const char* pool = file.data() + pool_offset;
+    size_t pool_size = file.size() - pool_offset;
+
+    auto text = [&](size_t offset, size_t length) {
+        if (offset + length > pool_size) {
+            throw std::runtime_error("Peer snapshot is corrupt: " + path);
+        }
+        return std::string(pool + offset, length);
+    };
+
+    std::map<std::string, PeerInfo> loaded_peers;
+    const auto* records = reinterpret_cast<const PeerSnapshotRecord*>(file.data() + records_offset);
+    for (uint32_t i = 0; i < header.peers; ++i) {
+        const PeerSnapshotRecord& record = records[i];
+        PeerInfo peer;
+        peer.address = Endpoint::fromIpv6Bytes(record.address, record.port);
+        peer.id = text(record.strings, record.id_length);
+        peer.room = text(size_t{record.strings} + record.id_length, record.room_length);
+        peer.registered_at = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(record.registered_ns));
+        if (record.ingress_port != 0) {
+            peer.ingress = Endpoint::fromIpv6Bytes(record.ingress, record.ingress_port);
+        }
+        loaded_peers.emplace_hint(loaded_peers.end(), peer.id, std::move(peer));
+    }
+
+    std::map<std::string, std::string> loaded_waiting;
+    const auto* entries = reinterpret_cast<const WaitingSnapshotRecord*>(file.data() + waiting_offset);
+    for (uint32_t i = 0; i < header.waiting; ++i) {
+        const WaitingSnapshotRecord& entry = entries[i];
+        loaded_waiting.emplace_hint(loaded_waiting.end(), text(entry.strings, entry.room_length),
+                                    text(size_t{entry.strings} + entry.room_length, entry.id_length));
+    }
+
+    SipHash::Key key;
+    std::memcpy(key.data(), header.cookie_key, key.size());
+    cookie = AddressCookie(key, std::chrono::steady_clock::time_point(
+                                    std::chrono::steady_clock::duration(header.cookie_epoch_ns)));
+    peers = std::move(loaded_peers);
+    waiting = std::move(loaded_waiting);
+}
+
+}  // namespace network
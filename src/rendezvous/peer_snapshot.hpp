@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../common/address_cookie.hpp"
+#include "rendezvous_server.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace network {
+
+// Pending registrations of a RendezvousServer in a file the next process maps and walks
+// without parsing, host byte order:
+//
+//   header          magic "P2PSNAP1", uint32 version, uint32 peer count, uint32 waiting
+//                   count, uint32 reserved, cookie key and cookie epoch
+//   peer records    PeerSnapshotRecord, in peer id order
+//   waiting records WaitingSnapshotRecord, in room order
+//   string pool     ids and rooms referenced by offset and length
+//
+// Both tables are written in std::map order so that loading appends every entry at the
+// end of its map in constant time. Times are CLOCK_MONOTONIC (steady_clock), which is
+// shared by every process on the host, so registration ages carry over unchanged.
+struct PeerSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t peers;
+    uint32_t waiting;
+    uint32_t reserved;
+    uint8_t cookie_key[16];
+    int64_t cookie_epoch_ns;
+};
+
+// Addresses are IPv6 in network order, IPv4 ones v4-mapped, see Endpoint::fromIpv6Bytes.
+struct PeerSnapshotRecord {
+    int64_t registered_ns;
+    uint8_t address[16];
+    uint8_t ingress[16];
+    uint16_t port;
+    uint16_t ingress_port;  // 0 if the peer registered locally
+    uint16_t id_length;
+    uint16_t room_length;
+    uint32_t strings;  // offset of the id, followed by the room, in the string pool
+    uint32_t reserved;
+};
+
+struct WaitingSnapshotRecord {
+    uint32_t strings;  // offset of the room, followed by the id
+    uint16_t room_length;
+    uint16_t id_length;
+};
+
+static_assert(sizeof(PeerSnapshotHeader) == 48, "snapshot header layout");
+static_assert(sizeof(PeerSnapshotRecord) == 56, "snapshot records must stay 8-byte aligned");
+static_assert(sizeof(WaitingSnapshotRecord) == 8, "snapshot records must stay 8-byte aligned");
+
+constexpr char PEER_SNAPSHOT_MAGIC[8] = {'P', '2', 'P', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t PEER_SNAPSHOT_VERSION = 2;
+
+// Writes the tables and the cookie key to `path`, readable by the owner only since the
+// key lets anyone mint valid cookies.
+void savePeerSnapshot(const std::string& path, const std::map<std::string, PeerInfo>& peers,
+                      const std::map<std::string, std::string>& waiting, const AddressCookie& cookie);
+
+// Replaces the contents of `peers`, `waiting` and `cookie` with the snapshot's.
+void loadPeerSnapshot(const std::string& path, std::map<std::string, PeerInfo>& peers,
+                      std::map<std::string, std::string>& waiting, AddressCookie& cookie);
+
+}  // namespace network
@@ -0,0 +1,317 @@
+#include "relay_server.hpp"
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace network {
+
+namespace {
+
+constexpr char BIND_PREFIX[] = "RELAY_BIND:";
+constexpr size_t BIND_PREFIX_SIZE = sizeof(BIND_PREFIX) - 1;
+
+// A busy session yields the thread after this many batches; epoll reports it again.
+constexpr size_t MAX_BATCHES_PER_WAKEUP = 8;
+
+int slotOf(const RelaySession& session, const Endpoint& addr) {
+    for (size_t i = 0; i < session.bound; ++i) {
+        if (session.peers[i] == addr) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+RelayServer::RelayServer(const std::string& address, uint16_t port, const RelayServerOptions& options)
+    : address_(address, port),
+      options_(options),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      running_(true),
+      rate_limiter_(options.rate_limit, options.rate_burst),
+      buffers_(BATCH_SIZE * MAX_DATAGRAM_SIZE),
+      recv_iovs_(BATCH_SIZE),
+      sources_(BATCH_SIZE),
+      recv_msgs_(BATCH_SIZE),
+      send_iovs_(BATCH_SIZE),
+      send_msgs_(BATCH_SIZE) {
+    if (epoll_fd_ < 0) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+        recv_iovs_[i].iov_base = buffers_.data() + i * MAX_DATAGRAM_SIZE;
+        recv_iovs_[i].iov_len = MAX_DATAGRAM_SIZE;
+        recv_msgs_[i].msg_hdr.msg_name = sources_[i].data();
+        recv_msgs_[i].msg_hdr.msg_iov = &recv_iovs_[i];
+        recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+
+        send_msgs_[i].msg_hdr.msg_iov = &send_iovs_[i];
+        send_msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    Logger::info("Relay server initialized on " + address_.toString());
+}
+
+RelayServer::~RelayServer() {
+    close(epoll_fd_);
+}
+
+void RelayServer::run() {
+    try {
+        SocketWrapper control(SocketWrapper::Type::UDP, SocketWrapper::familyFor(address_));
+        control.applyOptions(options_.socket);
+        control.bind(address_);
+        control.setNonBlocking(true);
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;  // sessions register themselves, the control socket is null
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, control.getFd(), &event) < 0) {
+            throw std::runtime_error("Failed to watch relay control socket");
+        }
+
+        Logger::info("Relay server listening on " + address_.toString());
+
+        std::vector<struct epoll_event> events(64);
+        auto last_expiry = std::chrono::steady_clock::now();
+
+        while (running_) {
+            int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), 1000);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("epoll_wait failed: " + std::string(strerror(errno)));
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i) {
+                if (events[i].data.ptr == nullptr) {
+                    handleControl(control);
+                } else {
+                    forward(*static_cast<RelaySession*>(events[i].data.ptr), now);
+                }
+            }
+
+            // Sessions are only closed here, never while `events` may still point at them.
+            if (now - last_expiry >= std::chrono::seconds(1)) {
+                expireSessions(now);
+                last_expiry = now;
+            }
+        }
+
+        while (!sessions_.empty()) {
+            closeSession(sessions_.begin());
+        }
+    } catch (const std::exception& e) {
+        Logger::error("Relay server error: " + std::string(e.what()));
+        throw;
+    }
+}
+
+void RelayServer::handleControl(SocketWrapper& control) {
+    ReceivedSegments received;
+    while (control.tryReceiveSegmentsFrom(received)) {
+        if (!rate_limiter_.allow(received.sender, std::chrono::steady_clock::now())) {
+            continue;
+        }
+
+        for (const auto& message : received.segments) {
+            auto [cmd, data] = Protocol::parse(message);
+            std::string response;
+
+            try {
+                switch (cmd) {
+                    case Command::RELAY_ALLOCATE:
+                        response = allocate(data, received.sender);
+                        break;
+
+                    case Command::PING:
+                        response = Protocol::createPong();
+                        break;
+
+                    default:
+                        response = Protocol::createError("Unknown command");
+                        break;
+                }
+                control.sendto(response, received.sender);
+            } catch (const std::exception& e) {
+                Logger::error("Error processing relay request: " + std::string(e.what()));
+            }
+        }
+    }
+}
+
+std::string RelayServer::allocate(const std::string& data, const Endpoint& sender) {
+    auto fields = Protocol::parseFields(data);
+
+    // As for REGISTER: no port is opened until the client proves it receives at its address.
+    auto now = std::chrono::steady_clock::now();
+    auto cookie = fields.find("cookie");
+    if (cookie == fields.end() || !cookie_.verify(cookie->second, sender, now)) {
+        return Protocol::serialize(Command::COOKIE, cookie_.make(sender, now));
+    }
+
+    std::string id = fields["session"];
+    if (id.empty() || id.size() > 64) {
+        return Protocol::createError("Invalid session id");
+    }
+
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+        if (sessions_.size() >= options_.max_sessions) {
+            Logger::warning("Relay session table full, rejecting " + id);
+            return Protocol::createError("Relay full");
+        }
+
+        auto session = std::make_unique<RelaySession>();
+        session->id = id;
+        session->socket = std::make_unique<SocketWrapper>(SocketWrapper::Type::UDP,
+                                                          SocketWrapper::familyFor(address_));
+        session->socket->applyOptions(options_.socket);
+        session->socket->bind(address_.ip(), 0);
+        session->socket->setNonBlocking(true);
+        session->port = session->socket->getLocalAddress().port();
+        session->last_active = now;
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = session.get();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, session->socket->getFd(), &event) < 0) {
+            throw std::runtime_error("Failed to watch relay session socket");
+        }
+
+        Logger::info("Allocated relay port " + std::to_string(session->port) + " for session " + id);
+        it = sessions_.emplace(id, std::move(session)).first;
+    }
+
+    return Protocol::serialize(Command::RELAY_ALLOCATE, "port=" + std::to_string(it->second->port));
+}
+
+void RelayServer::forward(RelaySession& session, std::chrono::steady_clock::time_point now) {
+    int fd = session.socket->getFd();
+
+    for (size_t batch = 0; batch < MAX_BATCHES_PER_WAKEUP; ++batch) {
+        for (auto& msg : recv_msgs_) {
+            msg.msg_hdr.msg_namelen = Endpoint::CAPACITY;
+            msg.msg_hdr.msg_flags = 0;
+        }
+
+        int received = ::recvmmsg(fd, recv_msgs_.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received <= 0) {
+            if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                Logger::debug("Relay receive failed: " + std::string(strerror(errno)));
+            }
+            return;
+        }
+
+        size_t count = 0;
+        for (int i = 0; i < received; ++i) {
+            const auto& header = recv_msgs_[i].msg_hdr;
+            const char* data = static_cast<const char*>(recv_iovs_[i].iov_base);
+            size_t size = recv_msgs_[i].msg_len;
+
+            if (header.msg_flags & MSG_TRUNC) {
+                Logger::debug("Relay dropped a datagram larger than " +
+                              std::to_string(MAX_DATAGRAM_SIZE) + " bytes");
+                continue;
+            }
+
+            int from = slotOf(session, sources_[i]);
+            if (from < 0 || (size >= BIND_PREFIX_SIZE &&
+                             std::memcmp(data, BIND_PREFIX, BIND_PREFIX_SIZE) == 0)) {
+                handleBind(session, sources_[i], data, size);
+                continue;
+            }
+
+            session.last_active = now;
+            if (session.bound < 2) {
+                continue;
+            }
+
+            // The outgoing iovec aliases the receive buffer: no payload copy.
+            send_iovs_[count].iov_base = recv_iovs_[i].iov_base;
+            send_iovs_[count].iov_len = size;
+            send_msgs_[count].msg_hdr.msg_name = session.peers[1 - from].data();
+            send_msgs_[count].msg_hdr.msg_namelen = session.peers[1 - from].length();
+            session.bytes += size;
+            ++count;
+        }
+
+        size_t sent = 0;
+        while (sent < count) {
+            int result = ::sendmmsg(fd, send_msgs_.data() + sent,
+                                    static_cast<unsigned int>(count - sent), MSG_DONTWAIT);
+            if (result < 0) {
+                Logger::debug("Relay dropped " + std::to_string(count - sent) +
+                              " datagrams: " + std::string(strerror(errno)));
+                break;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        session.packets += sent;
+
+        if (static_cast<size_t>(received) < BATCH_SIZE) {
+            return;
+        }
+    }
+}
+
+void RelayServer::handleBind(RelaySession& session, const Endpoint& source, const char* data,
+                             size_t size) {
+    // Datagrams from strangers are dropped silently unless they name this session.
+    auto [cmd, fields] = Protocol::parse(std::string(data, size));
+    if (cmd != Command::RELAY_BIND || Protocol::parseFields(fields)["session"] != session.id) {
+        return;
+    }
+
+    if (slotOf(session, source) < 0) {
+        if (session.bound == 2) {
+            Logger::warning("Relay session " + session.id + " already has two peers, ignoring " +
+                            source.unmapped().toString());
+            return;
+        }
+        session.peers[session.bound++] = source;
+        Logger::info("Peer " + source.unmapped().toString() + " bound to relay session " + session.id);
+        if (session.bound == 2) {
+            reply(session, Protocol::serialize(Command::RELAY_BIND, "READY"), session.peers[0]);
+        }
+    }
+
+    session.last_active = std::chrono::steady_clock::now();
+    reply(session, Protocol::serialize(Command::RELAY_BIND, session.bound == 2 ? "READY" : "OK"),
+          source);
+}
+
+void RelayServer::reply(RelaySession& session, const std::string& message, const Endpoint& to) {
+    if (::sendto(session.socket->getFd(), message.data(), message.size(), MSG_DONTWAIT, to.data(),
+                 to.length()) < 0) {
+        Logger::debug("Failed to answer " + to.unmapped().toString() + ": " +
+                      std::string(strerror(errno)));
+    }
+}
+
+void RelayServer::closeSession(std::map<std::string, std::unique_ptr<RelaySession>>::iterator it) {
+    auto& session = *it->second;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session.socket->getFd(), nullptr);
+    Logger::info("Closed relay session " + session.id + " after " + std::to_string(session.packets) +
+                 " datagrams, " + std::to_string(session.bytes) + " bytes");
+    sessions_.erase(it);
+}
+
+void RelayServer::expireSessions(std::chrono::steady_clock::time_point now) {
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        auto next = std::next(it);
+        auto ttl = it->second->bound == 0 ? UNBOUND_TTL : SESSION_TTL;
+        if (now - it->second->last_active > ttl) {
+            closeSession(it);
+        }
+        it = next;
+    }
+}
+
+}  // namespace network
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../common/socket_wrapper.hpp"
+#include "../common/address_cookie.hpp"
+#include "../common/logger.hpp"
+#include "../common/protocol.hpp"
+#include "../common/rate_limiter.hpp"
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace network {
+
+struct RelayServerOptions {
+    SocketOptions socket;
+    size_t max_sessions = 1024;
+    uint32_t rate_limit = 20;  // control datagrams per second per source IP, 0 disables
+    uint32_t rate_burst = 40;
+};
+
+// One relayed pair. Each session owns a UDP port; the first two addresses that bind to
+// it with the session id become its endpoints, and everything else arriving there from
+// one endpoint is forwarded verbatim to the other.
+struct RelaySession {
+    std::string id;
+    std::unique_ptr<SocketWrapper> socket;
+    uint16_t port = 0;
+    Endpoint peers[2];  // as the session socket reports them, v4-mapped if dual-stack
+    size_t bound = 0;
+    std::chrono::steady_clock::time_point last_active;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+};
+
+// TURN-style fallback for peers that cannot punch through their NATs. The control port
+// answers RELAY_ALLOCATE:session=<id> (the id the rendezvous handed both peers in
+// PEER_INFO) with the session's port, once the request echoes an AddressCookie as
+// ";cookie=<cookie>", so spoofed requests never allocate a port. Forwarding reads up to BATCH_SIZE datagrams with
+// one recvmmsg and writes them back out with one sendmmsg whose iovecs point into the
+// same receive buffers, so payloads are never copied in user space.
+class RelayServer {
+   public:
+    static constexpr size_t BATCH_SIZE = 64;
+    static constexpr size_t MAX_DATAGRAM_SIZE = 9216;  // jumbo frame payload; larger is dropped
+    static constexpr std::chrono::seconds SESSION_TTL{300};
+    // A session no peer has bound to yet; clients bind right after allocating.
+    static constexpr std::chrono::seconds UNBOUND_TTL{5};
+
+    RelayServer(const std::string& address, uint16_t port, const RelayServerOptions& options = {});
+    ~RelayServer();
+    void run();
+    void stop() { running_ = false; }
+
+   private:
+    void handleControl(SocketWrapper& control);
+    std::string allocate(const std::string& data, const Endpoint& sender);
+    void forward(RelaySession& session, std::chrono::steady_clock::time_point now);
+    void handleBind(RelaySession& session, const Endpoint& source, const char* data, size_t size);
+    void reply(RelaySession& session, const std::string& message, const Endpoint& to);
+    void closeSession(std::map<std::string, std::unique_ptr<RelaySession>>::iterator it);
+    void expireSessions(std::chrono::steady_clock::time_point now);
+
+    Endpoint address_;
+    RelayServerOptions options_;
+    int epoll_fd_;
+    std::atomic<bool> running_;
+    std::map<std::string, std::unique_ptr<RelaySession>> sessions_;
+    RateLimiter rate_limiter_;
+    AddressCookie cookie_;
+
+    // Shared by every session: each forward() drains one socket completely.
+    std::vector<char> buffers_;
+    std::vector<struct iovec> recv_iovs_;
+    std::vector<Endpoint> sources_;
+    std::vector<struct mmsghdr> recv_msgs_;
+    std::vector<struct iovec> send_iovs_;
+    std::vector<struct mmsghdr> send_msgs_;
+};
+
+}  // namespace network
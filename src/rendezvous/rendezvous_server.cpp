@@ -1,124 +1,447 @@
 #include "rendezvous_server.hpp"
+#include "../common/capture.hpp"
+#include "../common/io_backend.hpp"
+#include "../common/random.hpp"
+#include "../common/tracing.hpp"
+#include "peer_snapshot.hpp"
+#include <unistd.h>
+#include <cstdio>
 #include <sstream>
 #include <thread>
 #include <chrono>
 
 namespace network {
 
-RendezvousServer::RendezvousServer(const std::string& address, uint16_t port)
-    : address_(address), port_(port) {
-    Logger::info("Rendezvous server initialized on " + address + ":" + std::to_string(port));
+RendezvousServer::RendezvousServer(const std::string& address, uint16_t port,
+                                   const RendezvousServerOptions& options)
+    : address_(address, port),
+      options_(options),
+      running_(true),
+      rate_limiter_(options.rate_limit, options.rate_burst),
+      rate_limited_packets_(0),
+      rejected_cluster_messages_(0),
+      successor_(-1) {
+    if (!options_.cluster_members.empty()) {
+        std::string self =
+            options_.cluster_self.empty() ? address_.toString() : options_.cluster_self;
+        if (!options_.cluster_key) {
+            throw std::runtime_error("A cluster needs a shared cluster key");
+        }
+        cluster_ = std::make_unique<Cluster>(options_.cluster_members, self, *options_.cluster_key);
+    }
+    Logger::info("Rendezvous server initialized on " + address_.toString());
 }
 
 void RendezvousServer::run() {
     try {
-        SocketWrapper server_socket(SocketWrapper::Type::UDP);
-        server_socket.bind(address_, port_);
+        // Before anything is allocated, so that the peer table and io_uring's buffers
+        // come from the node of the cores serving them.
+        placeCurrentThread(options_.io_thread, "Rendezvous I/O");
+        Tracer::nameThread("Rendezvous I/O");
+        SocketWrapper server_socket = openSocket();
+        enableBusyPoll(server_socket, options_.io_thread, options_.socket);
+        if (!options_.handover_path.empty()) {
+            handover_ = std::make_unique<HandoverListener>(options_.handover_path);
+        }
 
-        Logger::info("Rendezvous server listening on " + address_ + ":" + std::to_string(port_));
+        bool capture = !options_.capture_path.empty();
+        Logger::info("Rendezvous server listening on " + address_.toString());
+        for (;;) {
+            auto io = createDatagramIo(options_.io_backend, server_socket);
+            if (capture) {
+                io = std::make_unique<CapturingIo>(std::move(io), options_.capture_path);
+            }
+            run(*io);
+            if (successor_ < 0) {
+                return;
+            }
 
-        while (true) {
-            try {
-                auto [message, sender_info] = server_socket.receivefrom();
-                auto [sender_ip, sender_port] = sender_info;
+            // Nothing in this process may read the socket once the successor owns it. run()
+            // already stopped receiving; if the successor fails, a new backend resumes.
+            io.reset();
+            if (handOver(server_socket)) {
+                return;
+            }
+            if (capture) {
+                Logger::warning("Capture stopped: reopening would truncate " + options_.capture_path);
+                capture = false;
+            }
+        }
+    } catch (const std::exception& e) {
+        Logger::error("Rendezvous server error: " + std::string(e.what()));
+        throw;
+    }
+}
+
+// Inherits the socket and registrations of a running server when one listens on the
+// handover path, otherwise binds a fresh socket.
+SocketWrapper RendezvousServer::openSocket() {
+    if (!options_.handover_path.empty()) {
+        auto takeover = Takeover::request(options_.handover_path, HANDOVER_TIMEOUT);
+        if (takeover) {
+            SocketWrapper socket(SocketWrapper::Type::UDP, takeover->releaseSocket());
+            socket.applyOptions(options_.socket);
+
+            auto start = std::chrono::steady_clock::now();
+            loadPeerSnapshot(takeover->snapshotPath(), peers_, waiting_, cookie_);
+            for (const auto& [id, peer] : peers_) {
+                peer_by_address_[peer.address] = id;
+                ++peers_per_ip_[peer.address.ip()];
+            }
+            ::unlink(takeover->snapshotPath().c_str());
+            takeover->confirm();
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            Logger::info("Took over socket and " + std::to_string(peers_.size()) +
+                         " registrations, state loaded in " + std::to_string(elapsed.count()) + " ms");
+            return socket;
+        }
+    }
+
+    SocketWrapper socket(SocketWrapper::Type::UDP, SocketWrapper::familyFor(address_));
+    socket.applyOptions(options_.socket);
+    socket.bind(address_);
+    return socket;
+}
+
+// Gives the socket and the peer table to the process waiting on successor_. Returns
+// false, with this process still owning the socket, if the successor fails.
+bool RendezvousServer::handOver(SocketWrapper& socket) {
+    auto start = std::chrono::steady_clock::now();
+    std::string snapshot = options_.handover_path + ".state";
+    int successor = successor_;
+    successor_ = -1;
+
+    try {
+        savePeerSnapshot(snapshot, peers_, waiting_, cookie_);
+    } catch (const std::exception& e) {
+        Logger::error("Failed to snapshot peer table: " + std::string(e.what()));
+        ::close(successor);
+        return false;
+    }
+    Logger::info("Handing over to successor with " + std::to_string(peers_.size()) + " registrations");
 
-                Logger::debug("Received from " + sender_ip + ":" + std::to_string(sender_port) +
-                            ": " + message);
+    if (!handover_->handOver(successor, socket.getFd(), snapshot, HANDOVER_TIMEOUT)) {
+        Logger::warning("Successor did not take over, resuming service");
+        ::unlink(snapshot.c_str());
+        return false;
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    Logger::info("Handed over in " + std::to_string(elapsed.count()) + " ms");
+    return true;
+}
 
-                handleClient(server_socket, message, sender_ip, sender_port);
+void RendezvousServer::run(DatagramIo& io) {
+    auto handler = [this, &io](const ReceivedSegments& received) {
+        IoThreadStats::Processing processing(stats_);
+        for (const auto& message : received.segments) {
+            if (Logger::enabled(Logger::Level::DEBUG)) {
+                Logger::debug("Received from " + received.sender.toString() + ": " + message);
+            }
+
+            try {
+                handleClient(io, message, received.sender);
             } catch (const std::exception& e) {
                 Logger::error("Error processing message: " + std::string(e.what()));
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
         }
-    } catch (const std::exception& e) {
-        Logger::error("Rendezvous server error: " + std::string(e.what()));
-        throw;
+    };
+
+    // Clustered nodes wake up often enough to keep heartbeats on schedule, and a server
+    // accepting handovers does not keep its successor waiting. A busy polling server
+    // never sleeps.
+    auto poll_timeout = std::chrono::milliseconds(cluster_ || handover_ ? 100 : 1000);
+    if (options_.io_thread.busy_poll) {
+        poll_timeout = std::chrono::milliseconds(0);
     }
+
+    while (running_ && !io.closed()) {
+        try {
+            stats_.poll([&] { return io.poll(handler, poll_timeout); });
+            if (cluster_) {
+                cluster_->tick(io, std::chrono::steady_clock::now());
+            }
+        } catch (const std::exception& e) {
+            Logger::error("Error processing message: " + std::string(e.what()));
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        if (handover_ && (successor_ = handover_->accept()) >= 0) {
+            // Answer what the backend already took off the socket before the table is saved;
+            // the rest stays queued in the socket for the successor.
+            size_t drained = io.stopReceiving(handler);
+            Logger::info("Successor requested handover, stopped reading (" +
+                         std::to_string(drained) + " taken datagrams answered)");
+            break;
+        }
+        stats_.reportIfDue("Rendezvous I/O");
+        Tracer::flushIfDue();
+    }
+    stats_.report("Rendezvous I/O");
 }
 
-void RendezvousServer::handleClient(SocketWrapper& socket, const std::string& message, const std::string& sender_ip,
-                                     uint16_t sender_port) {
+void RendezvousServer::handleClient(DatagramIo& socket, const std::string& message, const Endpoint& sender) {
+    TraceSpan span("handle_client", "rendezvous");
+    if (span.active()) {
+        span.setId(sender.toString());
+    }
+    bool from_node = cluster_ && message.compare(0, 8, "CLUSTER_") == 0 && cluster_->isMember(sender);
+
+    // Checked before parsing so a flood costs one hash and one table probe per packet.
+    // Other nodes carry many clients' traffic, so their cluster messages are exempt; those
+    // must carry the cluster MAC, which a packet spoofed from a node's address lacks.
+    TraceSpan rate_limit_span("rate_limit", "rendezvous");
+    if (!from_node && !rate_limiter_.allow(sender, std::chrono::steady_clock::now())) {
+        ++rate_limited_packets_;
+        if ((rate_limited_packets_ & (rate_limited_packets_ - 1)) == 0) {
+            Logger::warning("Rate limit exceeded by " + sender.ip() + ", " +
+                            std::to_string(rate_limited_packets_) + " packets dropped so far");
+        }
+        return;
+    }
+    rate_limit_span.end();
+
+    TraceSpan parse_span("parse", "rendezvous");
     auto [cmd, data] = Protocol::parse(message);
+    parse_span.end();
     std::string response;
 
     switch (cmd) {
-        case Command::REGISTER:
-            response = processRegister(data, sender_ip, sender_port);
-            if (peers_.size() >= 2) {
-                matchPeers(socket);
-            }
+        case Command::REGISTER: {
+            TraceSpan register_span("register", "rendezvous");
+            response = processRegister(socket, data, message.size(), sender);
             break;
+        }
 
         case Command::PING:
             response = Protocol::createPong();
             break;
 
+        case Command::CLUSTER_HEARTBEAT:
+        case Command::CLUSTER_REGISTER:
+        case Command::CLUSTER_PEER_INFO:
+            if (from_node && cluster_->verify(cmd, data)) {
+                TraceSpan cluster_span("cluster_message", "rendezvous");
+                handleClusterMessage(socket, cmd, data, sender);
+            } else {
+                ++rejected_cluster_messages_;
+                if ((rejected_cluster_messages_ & (rejected_cluster_messages_ - 1)) == 0) {
+                    Logger::warning("Unauthenticated cluster message from " + sender.toString() +
+                                    ", " + std::to_string(rejected_cluster_messages_) +
+                                    " dropped so far");
+                }
+            }
+            break;
+
         default:
-            Logger::warning("Unknown command from " + sender_ip + ":" + std::to_string(sender_port));
+            Logger::warning("Unknown command from " + sender.toString());
             response = Protocol::createError("Unknown command");
             break;
     }
 
     if (!response.empty()) {
+        TraceSpan send_span("send_response", "rendezvous");
         try {
-            socket.sendto(response, sender_ip, sender_port);
-            Logger::debug("Sent response to " + sender_ip + ":" + std::to_string(sender_port));
+            socket.sendto(response, sender);
+            if (Logger::enabled(Logger::Level::DEBUG)) {
+                Logger::debug("Sent response to " + sender.toString());
+            }
         } catch (const std::exception& e) {
             Logger::error("Failed to send response: " + std::string(e.what()));
         }
     }
 }
 
-std::string RendezvousServer::processRegister(const std::string& data, const std::string& sender_ip,
-                                               uint16_t sender_port) {
-    std::string client_id = data.empty() ? sender_ip + ":" + std::to_string(sender_port) : data;
+std::string RendezvousServer::processRegister(DatagramIo& socket, const std::string& data,
+                                               size_t request_size, const Endpoint& sender) {
+    auto now = std::chrono::steady_clock::now();
+    auto fields = Protocol::parseFields(data);
 
-    PeerInfo peer;
-    peer.ip = sender_ip;
-    peer.port = sender_port;
-    peer.id = client_id;
+    // No state is allocated until the client proves it receives at its source address.
+    TraceSpan cookie_span("verify_cookie", "rendezvous");
+    auto cookie = fields.find("cookie");
+    if (cookie == fields.end() ||
+        (options_.verify_cookies && !cookie_.verify(cookie->second, sender, now))) {
+        // Never answered with more bytes than were received, so that a spoofed request
+        // cannot be reflected with amplification; clients pad the first one.
+        std::string challenge = Protocol::serialize(Command::COOKIE, cookie_.make(sender, now));
+        return request_size >= challenge.size() ? challenge : "";
+    }
+    cookie_span.end();
 
-    peers_[client_id] = peer;
+    auto id = fields.find("id");
+    PeerInfo peer;
+    peer.address = sender;
+    peer.id = (id == fields.end() || id->second.empty()) ? sender.toString() : id->second;
+    peer.room = fields["room"];
+    peer.registered_at = now;
 
-    Logger::info("Registered peer: " + client_id + " at " + sender_ip + ":" +
-                 std::to_string(sender_port));
+    const ClusterNode* owner = cluster_ ? cluster_->ownerOf(peer.room) : nullptr;
+    if (owner != nullptr) {
+        TraceSpan forward_span("forward_register", "rendezvous");
+        std::string forward =
+            "id=" + peer.id + ";room=" + peer.room + ";addr=" + peer.address.toString();
+        socket.sendto(cluster_->sign(Command::CLUSTER_REGISTER, forward), owner->address);
+        Logger::info("Forwarded registration of " + peer.id + " to node " + owner->address.toString());
+        return Protocol::serialize(Command::REGISTER, "OK");
+    }
 
+    TraceSpan register_span("register_peer", "rendezvous");
+    if (!registerPeer(socket, peer)) {
+        return Protocol::createError("Server full");
+    }
     return Protocol::serialize(Command::REGISTER, "OK");
 }
 
-void RendezvousServer::matchPeers(SocketWrapper& socket) {
-    if (peers_.size() < 2) {
-        return;
+void RendezvousServer::handleClusterMessage(DatagramIo& socket, Command cmd, const std::string& data,
+                                            const Endpoint& sender) {
+    auto now = std::chrono::steady_clock::now();
+    cluster_->onHeartbeat(sender, now);
+
+    switch (cmd) {
+        case Command::CLUSTER_REGISTER: {
+            auto fields = Protocol::parseFields(data);
+
+            PeerInfo peer;
+            peer.address = Protocol::parsePeerInfo(fields["addr"]);
+            peer.id = fields["id"];
+            peer.room = fields["room"];
+            peer.registered_at = now;
+            peer.ingress = sender;
+            registerPeer(socket, peer);
+            break;
+        }
+
+        case Command::CLUSTER_PEER_INFO: {
+            // The client's NAT only admits replies from the node it registered with, so
+            // the owner hands the match back here for delivery.
+            auto fields = Protocol::parseFields(data);
+            Endpoint to = Protocol::parsePeerInfo(fields["to"]);
+            Endpoint peer = Protocol::parsePeerInfo(fields["peer"]);
+            socket.sendto(Protocol::createPeerInfo(peer, fields["session"]), to);
+            Logger::info("Delivered peer info to " + to.toString() + ": " + peer.toString());
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+bool RendezvousServer::registerPeer(DatagramIo& socket, const PeerInfo& peer) {
+    // A source address holds one registration: registering again, under this id or another,
+    // replaces the earlier one, so a client cannot fill the table by varying its id.
+    auto existing = peers_.find(peer.id);
+    if (existing != peers_.end()) {
+        removePeer(existing);
+    }
+    auto previous = peer_by_address_.find(peer.address);
+    if (previous != peer_by_address_.end()) {
+        auto it = peers_.find(previous->second);
+        if (it != peers_.end()) {
+            removePeer(it);
+        } else {
+            peer_by_address_.erase(previous);  // stale, e.g. from an older snapshot
+        }
     }
 
-    auto it1 = peers_.begin();
-    auto it2 = std::next(it1);
+    if (peers_.size() >= options_.max_peers) {
+        expirePeers(peer.registered_at);
+        if (peers_.size() >= options_.max_peers) {
+            Logger::warning("Peer table full, rejecting " + peer.id);
+            return false;
+        }
+    }
+    auto per_ip = peers_per_ip_.find(peer.address.ip());
+    if (options_.max_peers_per_ip != 0 && per_ip != peers_per_ip_.end() &&
+        per_ip->second >= options_.max_peers_per_ip) {
+        Logger::warning("Too many registrations from " + peer.address.ip() + ", rejecting " + peer.id);
+        return false;
+    }
 
-    std::string peer1_id = it1->first;
-    std::string peer2_id = it2->first;
+    Logger::info("Registered peer: " + peer.id + " at " + peer.address.toString() +
+                 (peer.room.empty() ? "" : " in room " + peer.room));
 
-    PeerInfo peer1 = it1->second;
-    PeerInfo peer2 = it2->second;
+    auto waiting = waiting_.find(peer.room);
+    if (waiting != waiting_.end()) {
+        auto other = peers_.find(waiting->second);
+        if (other != peers_.end()) {
+            PeerInfo partner = other->second;
+            removePeer(other);
+            matchPeers(socket, partner, peer);
+            return true;
+        }
+    }
 
-    Logger::info("Matching peers: " + peer1_id + " <-> " + peer2_id);
+    addPeer(peer);
+    return true;
+}
 
-    std::string peer1_info = Protocol::createPeerInfo(peer2.ip, peer2.port);
-    std::string peer2_info = Protocol::createPeerInfo(peer1.ip, peer1.port);
+void RendezvousServer::addPeer(const PeerInfo& peer) {
+    peers_[peer.id] = peer;
+    waiting_[peer.room] = peer.id;
+    peer_by_address_[peer.address] = peer.id;
+    ++peers_per_ip_[peer.address.ip()];
+}
 
-    try {
-        socket.sendto(peer1_info, peer1.ip, peer1.port);
-        Logger::info("Sent peer info to " + peer1_id + ": " + peer2.ip + ":" +
-                     std::to_string(peer2.port));
+void RendezvousServer::removePeer(std::map<std::string, PeerInfo>::iterator peer) {
+    auto waiting = waiting_.find(peer->second.room);
+    if (waiting != waiting_.end() && waiting->second == peer->first) {
+        waiting_.erase(waiting);
+    }
+    auto address = peer_by_address_.find(peer->second.address);
+    if (address != peer_by_address_.end() && address->second == peer->first) {
+        peer_by_address_.erase(address);
+    }
+    auto per_ip = peers_per_ip_.find(peer->second.address.ip());
+    if (per_ip != peers_per_ip_.end() && --per_ip->second == 0) {
+        peers_per_ip_.erase(per_ip);
+    }
+    peers_.erase(peer);
+}
+
+void RendezvousServer::expirePeers(std::chrono::steady_clock::time_point now) {
+    for (auto it = peers_.begin(); it != peers_.end();) {
+        if (now - it->second.registered_at > PEER_TTL) {
+            Logger::info("Registration of " + it->first + " expired");
+            removePeer(it++);
+        } else {
+            ++it;
+        }
+    }
+}
 
-        socket.sendto(peer2_info, peer2.ip, peer2.port);
-        Logger::info("Sent peer info to " + peer2_id + ": " + peer1.ip + ":" +
-                     std::to_string(peer1.port));
+void RendezvousServer::matchPeers(DatagramIo& socket, const PeerInfo& peer1, const PeerInfo& peer2) {
+    Logger::info("Matching peers: " + peer1.id + " <-> " + peer2.id);
 
-        peers_.clear();
+    // Unguessable, so only the two peers can claim their pair at a relay.
+    uint64_t session_bits;
+    fillRandom(&session_bits, sizeof(session_bits));
+    char session[17];
+    std::snprintf(session, sizeof(session), "%016llx", static_cast<unsigned long long>(session_bits));
+
+    // Carries the id the clients tag their spans with, to line both traces up.
+    TraceSpan span("send_peer_info", "rendezvous");
+    if (span.active()) {
+        span.setId(session);
+    }
+    try {
+        sendPeerInfo(socket, peer1, peer2, session);
+        sendPeerInfo(socket, peer2, peer1, session);
     } catch (const std::exception& e) {
         Logger::error("Failed to send peer info: " + std::string(e.what()));
     }
 }
 
+void RendezvousServer::sendPeerInfo(DatagramIo& socket, const PeerInfo& to, const PeerInfo& peer,
+                                    const std::string& session) {
+    if (to.ingress.empty()) {
+        socket.sendto(Protocol::createPeerInfo(peer.address, session), to.address);
+    } else {
+        std::string route = "to=" + to.address.toString() + ";peer=" + peer.address.toString() +
+                            ";session=" + session;
+        socket.sendto(cluster_->sign(Command::CLUSTER_PEER_INFO, route), to.ingress);
+    }
+    Logger::info("Sent peer info to " + to.id + ": " + peer.address.toString());
+}
+
 }  // namespace network
@@ -1,33 +1,94 @@
 #pragma once
 
 #include "../common/socket_wrapper.hpp"
+#include "../common/address_cookie.hpp"
+#include "../common/datagram_io.hpp"
+#include "../common/io_thread.hpp"
 #include "../common/protocol.hpp"
 #include "../common/logger.hpp"
+#include "../common/rate_limiter.hpp"
+#include "cluster.hpp"
+#include "handover.hpp"
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <map>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace network {
 
 struct PeerInfo {
-    std::string ip;
-    uint16_t port;
+    Endpoint address;
     std::string id;
+    std::string room;
+    std::chrono::steady_clock::time_point registered_at;
+    Endpoint ingress;  // cluster node the peer registered through, empty if local
+};
+
+struct RendezvousServerOptions {
+    SocketOptions socket;
+    IoBackend io_backend = IoBackend::EPOLL;
+    IoThreadOptions io_thread;  // placement and busy polling of the thread calling run()
+    uint32_t rate_limit = 50;  // datagrams per second per source IP, 0 disables
+    uint32_t rate_burst = 100;
+    size_t max_peers = 4096;   // registrations waiting for a match
+    size_t max_peers_per_ip = 32;  // of those, from one source IP, 0 disables
+    std::vector<std::string> cluster_members;  // "ip:port" of every node, empty = standalone
+    std::string cluster_self;                  // this node's entry, defaults to address:port
+    std::optional<SipHash::Key> cluster_key;   // shared by every node, required in a cluster
+    std::string capture_path;  // record received datagrams here, see CaptureWriter
+    bool verify_cookies = true;  // off for replays: captured cookies used another key
+    std::string handover_path;  // Unix socket for zero-downtime restarts, see HandoverListener
 };
 
 class RendezvousServer {
    public:
-    RendezvousServer(const std::string& address, uint16_t port);
+    static constexpr std::chrono::seconds PEER_TTL{60};
+    static constexpr std::chrono::seconds HANDOVER_TIMEOUT{10};
+
+    RendezvousServer(const std::string& address, uint16_t port,
+                     const RendezvousServerOptions& options = {});
     void run();
+    // Serves an already built backend, e.g. a ReplayIo, until stop(), until it closes or
+    // until a successor asks for a handover.
+    void run(DatagramIo& io);
+    void stop() { running_ = false; }
+    // Read once run() has returned.
+    const IoThreadStats& stats() const { return stats_; }
 
    private:
-    void handleClient(SocketWrapper& socket, const std::string& message, const std::string& sender_ip, uint16_t sender_port);
-    std::string processRegister(const std::string& data, const std::string& sender_ip, uint16_t sender_port);
-    void matchPeers(SocketWrapper& socket);
+    SocketWrapper openSocket();
+    bool handOver(SocketWrapper& socket);
+    void handleClient(DatagramIo& socket, const std::string& message, const Endpoint& sender);
+    std::string processRegister(DatagramIo& socket, const std::string& data, size_t request_size,
+                                const Endpoint& sender);
+    void handleClusterMessage(DatagramIo& socket, Command cmd, const std::string& data,
+                              const Endpoint& sender);
+    bool registerPeer(DatagramIo& socket, const PeerInfo& peer);
+    void addPeer(const PeerInfo& peer);
+    void removePeer(std::map<std::string, PeerInfo>::iterator peer);
+    void matchPeers(DatagramIo& socket, const PeerInfo& peer1, const PeerInfo& peer2);
+    void sendPeerInfo(DatagramIo& socket, const PeerInfo& to, const PeerInfo& peer,
+                      const std::string& session);
+    void expirePeers(std::chrono::steady_clock::time_point now);
 
-    std::string address_;
-    uint16_t port_;
+    Endpoint address_;
+    RendezvousServerOptions options_;
     std::map<std::string, PeerInfo> peers_;
+    std::map<std::string, std::string> waiting_;  // room -> id of the peer waiting in it
+    std::map<Endpoint, std::string> peer_by_address_;  // source address -> id registered from it
+    std::map<std::string, size_t> peers_per_ip_;
+    std::unique_ptr<Cluster> cluster_;
+    std::atomic<bool> running_;
+    AddressCookie cookie_;
+    RateLimiter rate_limiter_;
+    uint64_t rate_limited_packets_;
+    uint64_t rejected_cluster_messages_;
+    std::unique_ptr<HandoverListener> handover_;
+    int successor_;  // connection of a process waiting to take over, -1 if none
+    IoThreadStats stats_;
 };
 
 }  // namespace network
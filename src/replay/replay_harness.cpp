@@ -0,0 +1,66 @@
+#include "replay_harness.hpp"
+#include "../common/replay_io.hpp"
+#include "../p2p/p2p_client.hpp"
+#include "../rendezvous/rendezvous_server.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace network {
+
+namespace {
+
+double percentile(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    return static_cast<double>(values[index]);
+}
+
+}  // namespace
+
+void runReplay(const ReplayOptions& options) {
+    if (options.capture_path.empty()) {
+        throw std::runtime_error("replay requires --capture");
+    }
+
+    auto io = std::make_unique<ReplayIo>(options.capture_path, options.speed);
+    ReplayIo* replay = io.get();
+    Logger::setLevel(Logger::Level::WARNING);
+
+    std::unique_ptr<P2PClient> client;  // owns the replay once it runs, so it outlives the report
+    auto start = std::chrono::steady_clock::now();
+    if (options.target == "rendezvous") {
+        RendezvousServerOptions server_options;
+        server_options.rate_limit = 0;
+        server_options.verify_cookies = false;
+        RendezvousServer server("127.0.0.1", 0, server_options);
+        server.run(*io);
+    } else if (options.target == "p2p-client") {
+        P2PClientOptions client_options;
+        client_options.mtu_probing = false;  // probes would go nowhere and skew poll timing
+        client_options.encryption = options.encryption;
+        client_options.compression = options.compression;
+        client = std::make_unique<P2PClient>("127.0.0.1", 0, client_options);
+        client->replay(std::move(io), replay->firstSender());
+    } else {
+        throw std::runtime_error("Invalid replay target: " + options.target);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto& times = replay->handlerTimes();
+    std::cout << "Replayed " << replay->delivered() << " of " << replay->size() << " datagrams into "
+              << options.target << " in " << elapsed * 1000 << " ms";
+    if (options.speed > 0) {
+        std::cout << " at " << options.speed << "x recorded pace";
+    }
+    std::cout << "\n";
+    std::cout << "Throughput: " << static_cast<double>(replay->delivered()) / elapsed
+              << " datagrams/s, " << replay->sentDatagrams() << " datagrams sent in response\n";
+    std::cout << "Handler latency (ns): p50 " << percentile(times, 0.5) << ", p99 "
+              << percentile(times, 0.99) << ", p99.9 " << percentile(times, 0.999) << ", max "
+              << percentile(times, 1.0) << "\n";
+}
+
+}  // namespace network
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+namespace network {
+
+struct ReplayOptions {
+    std::string capture_path;
+    std::string target = "rendezvous";  // rendezvous or p2p-client
+    double speed = 0;                   // 1 = recorded pace, 0 = as fast as possible
+    bool encryption = true;             // p2p-client only, must match the capture
+    bool compression = true;
+};
+
+// Feeds a capture taken with --capture into the receive handlers of a rendezvous server
+// or a P2P client, without sockets, and reports the throughput and per-datagram handler
+// latency.
+//
+// Rendezvous replays run without cookie checks and rate limiting: captured cookies were
+// minted under another process's key, and accelerated playback would trip the limiter.
+// Sealed P2P traffic cannot be opened without the original session keys, which are
+// never stored, so P2P replays only exercise the full path for unencrypted captures.
+void runReplay(const ReplayOptions& options);
+
+}  // namespace network
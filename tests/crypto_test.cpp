@@ -0,0 +1,181 @@
+// Known-answer and consistency checks for the in-tree cryptography: the RFC 8439 AEAD
+// vector, the four-block ChaCha20 kernel against the one-block path, RFC 7748 X25519,
+// HChaCha20 and the replay window. Exits non-zero if any check fails.
+#include "common/chacha20_poly1305.hpp"
+#include "common/secure_channel.hpp"
+#include "common/x25519.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace network;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+std::vector<uint8_t> fromHex(const std::string& hex) {
+    std::vector<uint8_t> bytes(hex.size() / 2);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<uint8_t>(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return bytes;
+}
+
+template <typename Array>
+Array arrayFromHex(const std::string& hex) {
+    std::vector<uint8_t> bytes = fromHex(hex);
+    Array array{};
+    std::memcpy(array.data(), bytes.data(), std::min(bytes.size(), array.size()));
+    return array;
+}
+
+template <typename A, typename B>
+bool equal(const A& a, const B& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// RFC 8439 section 2.8.2.
+void testAeadVector() {
+    auto key = arrayFromHex<ChaCha20Poly1305::Key>(
+        "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f");
+    auto nonce = arrayFromHex<ChaCha20Poly1305::Nonce>("070000004041424344454647");
+    std::vector<uint8_t> aad = fromHex("50515253c0c1c2c3c4c5c6c7");
+    std::string text =
+        "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the "
+        "future, sunscreen would be it.";
+    std::vector<uint8_t> expected = fromHex(
+        "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+        "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+        "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+        "3ff4def08e4b7a9de576d26586cec64b6116");
+    auto expected_tag = arrayFromHex<ChaCha20Poly1305::Tag>("1ae10b594f09e26a7e902ecbd0600691");
+
+    ChaCha20Poly1305 aead(key);
+    std::vector<uint8_t> data(text.begin(), text.end());
+    auto tag = aead.seal(nonce, data.data(), data.size(), aad.data(), aad.size());
+    check(equal(data, expected), "RFC 8439 2.8.2 ciphertext");
+    check(equal(tag, expected_tag), "RFC 8439 2.8.2 tag");
+
+    check(aead.open(nonce, data.data(), data.size(), tag.data(), aad.data(), aad.size()) &&
+              std::string(data.begin(), data.end()) == text,
+          "RFC 8439 2.8.2 open");
+
+    aead.seal(nonce, data.data(), data.size(), aad.data(), aad.size());
+    data[7] ^= 1;
+    check(!aead.open(nonce, data.data(), data.size(), tag.data(), aad.data(), aad.size()),
+          "RFC 8439 2.8.2 open rejects a flipped ciphertext bit");
+}
+
+// chacha20Xor runs the four-block kernel over whole 256-byte runs and the one-block path
+// over the rest; 64-byte calls take the one-block path only.
+void testFourBlockKernel() {
+    auto key = arrayFromHex<ChaCha20Poly1305::Key>(
+        "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+    auto nonce = fromHex("000000000000004a00000000");
+    for (size_t length : {1, 63, 65, 255, 257, 300, 511, 513, 777, 1000, 1472, 4099}) {
+        std::vector<uint8_t> batched(length);
+        for (size_t i = 0; i < length; ++i) {
+            batched[i] = static_cast<uint8_t>(i * 7);
+        }
+        std::vector<uint8_t> single = batched;
+
+        ChaCha20Poly1305::chacha20Xor(key.data(), 1, nonce.data(), batched.data(), length);
+        uint32_t counter = 1;
+        for (size_t offset = 0; offset < length; offset += 64) {
+            ChaCha20Poly1305::chacha20Xor(key.data(), counter++, nonce.data(),
+                                          single.data() + offset, std::min<size_t>(64, length - offset));
+        }
+        check(batched == single, "four-block keystream matches one-block at " +
+                                     std::to_string(length) + " bytes");
+    }
+}
+
+// RFC 7748 section 6.1.
+void testX25519() {
+    auto alice_private = arrayFromHex<X25519::Key>(
+        "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+    auto alice_public = arrayFromHex<X25519::Key>(
+        "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+    auto bob_private = arrayFromHex<X25519::Key>(
+        "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb");
+    auto bob_public = arrayFromHex<X25519::Key>(
+        "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+    auto shared = arrayFromHex<X25519::Key>(
+        "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+
+    check(X25519::publicKey(alice_private) == alice_public, "RFC 7748 6.1 Alice's public key");
+    check(X25519::publicKey(bob_private) == bob_public, "RFC 7748 6.1 Bob's public key");
+
+    X25519::Key alice_shared;
+    X25519::Key bob_shared;
+    check(X25519::sharedSecret(alice_private, bob_public, alice_shared) && alice_shared == shared,
+          "RFC 7748 6.1 shared secret, Alice's side");
+    check(X25519::sharedSecret(bob_private, alice_public, bob_shared) && bob_shared == shared,
+          "RFC 7748 6.1 shared secret, Bob's side");
+
+    X25519::Key low_order{};
+    X25519::Key out;
+    check(!X25519::sharedSecret(alice_private, low_order, out), "low-order peer key rejected");
+}
+
+// draft-irtf-cfrg-xchacha section 2.2.1.
+void testHChaCha20() {
+    auto key = fromHex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+    auto input = fromHex("000000090000004a0000000031415927");
+    auto expected = arrayFromHex<ChaCha20Poly1305::Key>(
+        "82413b4227b27bfed30e42508a877d73a0f9e4d58a74a853c12ec41326d3ecdc");
+    check(ChaCha20Poly1305::hchacha20(key.data(), input.data()) == expected, "HChaCha20 vector");
+}
+
+void testReplayWindow() {
+    ReplayWindow window;
+    check(window.check(10), "first counter accepted");
+    window.update(10);
+    check(!window.check(10), "duplicate rejected");
+    check(window.check(11) && window.check(9), "unseen neighbours accepted");
+
+    // Window edge: WINDOW_SIZE - 1 behind the highest counter is still tracked.
+    const uint64_t highest = 2000;
+    window.update(highest);
+    check(!window.check(highest - ReplayWindow::WINDOW_SIZE), "counter just outside the window rejected");
+    check(window.check(highest - ReplayWindow::WINDOW_SIZE + 1), "oldest counter in the window accepted");
+    window.update(highest - ReplayWindow::WINDOW_SIZE + 1);
+    check(!window.check(highest - ReplayWindow::WINDOW_SIZE + 1), "oldest counter in the window, replayed");
+
+    // Far jump: every bitmap word is reused, so no bit of the old window may survive.
+    const uint64_t far = 1000000;
+    window.update(far);
+    check(!window.check(highest), "counter from before a far jump rejected");
+    uint64_t aliased = far - (far - highest) % (ReplayWindow::WORDS * 64);
+    check(aliased != far && window.check(aliased), "bit aliasing an old counter cleared by a far jump");
+    check(!window.check(far), "far jump target replayed");
+    check(window.check(far + 1), "counter after a far jump accepted");
+}
+
+}  // namespace
+
+int main() {
+    testAeadVector();
+    testFourBlockKernel();
+    testX25519();
+    testHChaCha20();
+    testReplayWindow();
+
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("All crypto checks passed\n");
+    return 0;
+}